@@ -0,0 +1,466 @@
+// Benchmark harness for josh.
+//
+// It links against the shell modules (everything but main.c) to measure the
+// internals directly, and runs the josh binary itself for the end-to-end
+// metrics. Results are printed as tab separated values, one metric per line:
+//
+//     metric <TAB> value <TAB> unit <TAB> better
+//
+// where `better` is "higher" or "lower". A previous run saved to a file can be
+// given with --compare, and every metric that got worse by more than the
+// threshold is reported as a regression (and the exit status is 1). The exit
+// status is 2 if the baseline or the output file can't be opened.
+//
+// Usage: josh_bench [--shell PATH] [--output FILE] [--compare FILE]
+//                   [--threshold PERCENT]
+
+#include "../builtins.h"  // For builtin_exists, builtin_execute
+#include "../constants.h" // For DEFAULT_PROMPT_CLOSING
+#include "../expand.h"    // For expansion_create, expansion_next
+#include "../io.h"        // For io_init
+#include "../parser.h"    // For parse_arguments, parsed_input_destroy
+#include "../process.h"   // For launch_process
+#include "../prompt.h"    // For print_prompt
+#include "../timing.h"    // For timing_now
+#include <fcntl.h>        // For open
+#include <signal.h>       // For kill, SIGKILL
+#include <stdbool.h>      // For bool
+#include <stdint.h>       // For uint64_t
+#include <stdio.h>        // For printf, fopen
+#include <stdlib.h>       // For malloc, free, strtod
+#include <string.h>       // For strcmp, strstr
+#include <sys/types.h>    // For pid_t
+#include <sys/wait.h>     // For waitpid
+#include <unistd.h>       // For fork, dup2, pipe
+
+// Array sizes must be integer constant expressions in C, so an enum is used
+// here instead of `static const`.
+enum
+{
+    MAX_METRICS = 32,
+    METRIC_NAME_LENGTH = 64,
+};
+
+typedef struct
+{
+    char name[METRIC_NAME_LENGTH];
+    double value;
+    const char *unit;
+    bool higher_is_better;
+} Metric;
+
+static Metric metrics[MAX_METRICS];
+static int metric_count = 0;
+
+// --- Iteration counts, chosen so a full run takes a few seconds ---
+static const int TOKENIZER_INPUT_WORDS = 200000;
+static const int TOKENIZER_ROUNDS = 20;
+static const int BUILTIN_DISPATCH_ROUNDS = 1000000;
+static const char *EXPANSION_WORD = "x{a,b,c}{1..1000000}";
+static const int SPAWN_ROUNDS = 500;
+static const int SCRIPT_LINES = 20000;
+static const int PROMPT_ROUNDS = 200000;
+static const int STARTUP_ROUNDS = 50;
+
+// =================================================================
+// Helpers
+// =================================================================
+
+static void metric_add(const char *name, double value, const char *unit, bool higher_is_better)
+{
+    if (metric_count >= MAX_METRICS)
+    {
+        return;
+    }
+
+    Metric *metric = &metrics[metric_count++];
+    snprintf(metric->name, sizeof(metric->name), "%s", name);
+    metric->value = value;
+    metric->unit = unit;
+    metric->higher_is_better = higher_is_better;
+}
+
+/**
+ * @brief Points stdout to /dev/null, so the output of the code being measured
+ *  does not end up mixed with the results.
+ *
+ * @return A duplicate of the original stdout, to be given to restore_stdout.
+ */
+static int silence_stdout(void)
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    return saved;
+}
+
+static void restore_stdout(int saved)
+{
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+// =================================================================
+// Benchmarks
+// =================================================================
+
+static void bench_tokenizer(void)
+{
+    // A long line made of words of varying length
+    static const char *WORDS[] = {"ls", "--color=auto", "-la", "/usr/share/doc", "x", "some_longer_argument"};
+    const size_t words_count = sizeof(WORDS) / sizeof(WORDS[0]);
+
+    size_t line_size = 0;
+    for (int i = 0; i < TOKENIZER_INPUT_WORDS; i++)
+    {
+        line_size += strlen(WORDS[i % words_count]) + 1;
+    }
+
+    char *line = malloc(line_size + 1);
+    char *cursor = line;
+    for (int i = 0; i < TOKENIZER_INPUT_WORDS; i++)
+    {
+        cursor += sprintf(cursor, "%s ", WORDS[i % words_count]);
+    }
+
+    double start = timing_now();
+    for (int round = 0; round < TOKENIZER_ROUNDS; round++)
+    {
+        ParsedInput parsed = parse_arguments(line);
+        parsed_input_destroy(&parsed);
+    }
+    double elapsed = timing_now() - start;
+
+    metric_add("tokenizer_throughput", (double)line_size * TOKENIZER_ROUNDS / elapsed / (1024 * 1024), "MiB/s", true);
+    metric_add("tokenizer_words", (double)TOKENIZER_INPUT_WORDS * TOKENIZER_ROUNDS / elapsed, "words/s", true);
+
+    free(line);
+}
+
+static void bench_expansion(void)
+{
+    Expansion *expansion = expansion_create(EXPANSION_WORD);
+    uint64_t words = 0;
+
+    double start = timing_now();
+    while (expansion_next(expansion) != NULL)
+    {
+        words++;
+    }
+    double elapsed = timing_now() - start;
+
+    expansion_destroy(expansion);
+
+    metric_add("brace_expansion_words", words / elapsed, "words/s", true);
+}
+
+static void bench_builtin_dispatch(void)
+{
+    // `trace flush` with tracing disabled does nothing, so only the cost of
+    // looking up and dispatching the builtin is measured.
+    char *arguments[] = {"trace", "flush", NULL};
+    ParsedInput parsed = {.count = 2, .arguments = arguments};
+    CommandIO io;
+    io_init(&io, STDIN_FILENO, STDOUT_FILENO);
+
+    double start = timing_now();
+    for (int round = 0; round < BUILTIN_DISPATCH_ROUNDS; round++)
+    {
+        if (builtin_exists(parsed.arguments[0]))
+        {
+            builtin_execute(&parsed, &io);
+        }
+    }
+    double elapsed = timing_now() - start;
+
+    metric_add("builtin_dispatch_latency", elapsed / BUILTIN_DISPATCH_ROUNDS * 1e9, "ns/op", false);
+}
+
+static void bench_spawn(void)
+{
+    char *arguments[] = {"/bin/true", NULL};
+    ParsedInput parsed = {.count = 1, .arguments = arguments};
+
+    double start = timing_now();
+    for (int round = 0; round < SPAWN_ROUNDS; round++)
+    {
+        launch_process(&parsed, NULL, 0);
+    }
+    double elapsed = timing_now() - start;
+
+    metric_add("spawn_true_latency", elapsed / SPAWN_ROUNDS * 1e6, "us/op", false);
+}
+
+static void bench_prompt(void)
+{
+    int saved = silence_stdout();
+
+    double start = timing_now();
+    for (int round = 0; round < PROMPT_ROUNDS; round++)
+    {
+        // Alternate between the plain prompt and the one with an exit status,
+        // and flush like an interactive terminal would.
+        print_prompt(round & 1);
+        fflush(stdout);
+    }
+    double elapsed = timing_now() - start;
+
+    restore_stdout(saved);
+
+    metric_add("prompt_render_latency", elapsed / PROMPT_ROUNDS * 1e9, "ns/op", false);
+}
+
+/**
+ * @brief Runs the shell on the given script file (`josh FILE`), with stdin
+ *  and stdout going to /dev/null, waiting for it to finish.
+ *
+ * @return Wall time taken by the shell, or a negative value on failure.
+ */
+static double run_shell_script(const char *shell, const char *script_path)
+{
+    double start = timing_now();
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        execl(shell, shell, script_path, (char *)NULL);
+        _exit(127);
+    }
+    else if (pid < 0)
+    {
+        return -1;
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    double elapsed = timing_now() - start;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "josh_bench: %s %s: failed\n", shell, script_path);
+        return -1;
+    }
+
+    return elapsed;
+}
+
+static void bench_script(const char *shell)
+{
+    char script_path[] = "/tmp/josh_bench_XXXXXX";
+    int script_fd = mkstemp(script_path);
+    if (script_fd == -1)
+    {
+        perror("josh_bench: mkstemp");
+        return;
+    }
+
+    FILE *script = fdopen(script_fd, "w");
+    for (int line = 0; line < SCRIPT_LINES; line++)
+    {
+        fprintf(script, "trace flush\n");
+    }
+    fclose(script);
+
+    double elapsed = run_shell_script(shell, script_path);
+    unlink(script_path);
+
+    if (elapsed > 0)
+    {
+        metric_add("script_builtin_throughput", SCRIPT_LINES / elapsed, "lines/s", true);
+    }
+}
+
+static void bench_startup(const char *shell)
+{
+    double total = 0;
+
+    for (int round = 0; round < STARTUP_ROUNDS; round++)
+    {
+        int output_pipe[2];
+        if (pipe(output_pipe) == -1)
+        {
+            perror("josh_bench: pipe");
+            return;
+        }
+
+        double start = timing_now();
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            // stdin stays open on an empty pipe so the shell blocks on its
+            // first read instead of exiting
+            int input_pipe[2];
+            pipe(input_pipe);
+            dup2(input_pipe[0], STDIN_FILENO);
+            dup2(output_pipe[1], STDOUT_FILENO);
+            close(output_pipe[0]);
+            execl(shell, shell, (char *)NULL);
+            _exit(127);
+        }
+        close(output_pipe[1]);
+
+        // The first prompt is there once its closing part has been printed
+        char output[256] = {0};
+        size_t used = 0;
+        ssize_t bytes;
+        while (used < sizeof(output) - 1 &&
+               (bytes = read(output_pipe[0], output + used, sizeof(output) - 1 - used)) > 0)
+        {
+            used += bytes;
+            if (strstr(output, DEFAULT_PROMPT_CLOSING) != NULL)
+            {
+                break;
+            }
+        }
+        total += timing_now() - start;
+
+        close(output_pipe[0]);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+
+    metric_add("startup_to_prompt", total / STARTUP_ROUNDS * 1e6, "us", false);
+}
+
+// =================================================================
+// Output and comparison
+// =================================================================
+
+static void write_metrics(FILE *stream)
+{
+    fprintf(stream, "# metric\tvalue\tunit\tbetter\n");
+    for (int i = 0; i < metric_count; i++)
+    {
+        fprintf(stream, "%s\t%.3f\t%s\t%s\n", metrics[i].name, metrics[i].value, metrics[i].unit,
+                metrics[i].higher_is_better ? "higher" : "lower");
+    }
+}
+
+/**
+ * @brief Compares the current metrics against a baseline file written by a
+ *  previous run, reporting the changes to stderr.
+ *
+ * @return The number of regressions found, or -1 if the file can't be read.
+ */
+static int compare_metrics(const char *baseline_path, double threshold_percent)
+{
+    FILE *baseline = fopen(baseline_path, "r");
+    if (baseline == NULL)
+    {
+        perror("josh_bench: baseline");
+        return -1;
+    }
+
+    int regressions = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), baseline) != NULL)
+    {
+        char name[METRIC_NAME_LENGTH];
+        double old_value;
+        if (line[0] == '#' || sscanf(line, "%63s %lf", name, &old_value) != 2 || old_value == 0)
+        {
+            continue;
+        }
+
+        for (int i = 0; i < metric_count; i++)
+        {
+            if (strcmp(metrics[i].name, name) != 0)
+            {
+                continue;
+            }
+
+            double change = (metrics[i].value - old_value) / old_value * 100;
+            double worse = metrics[i].higher_is_better ? -change : change;
+            bool regressed = worse > threshold_percent;
+
+            fprintf(stderr, "%-28s %12.3f -> %12.3f %-8s %+7.1f%%%s\n", name, old_value, metrics[i].value,
+                    metrics[i].unit, change, regressed ? "  REGRESSION" : "");
+            regressions += regressed;
+        }
+    }
+
+    fclose(baseline);
+    return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *shell = "./josh";
+    const char *output_path = NULL;
+    const char *baseline_path = NULL;
+    double threshold_percent = 10;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--shell") && i + 1 < argc)
+        {
+            shell = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--output") && i + 1 < argc)
+        {
+            output_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--compare") && i + 1 < argc)
+        {
+            baseline_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--threshold") && i + 1 < argc)
+        {
+            threshold_percent = strtod(argv[++i], NULL);
+        }
+        else
+        {
+            fprintf(stderr,
+                    "usage: %s [--shell PATH] [--output FILE] [--compare FILE] [--threshold PERCENT]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    bench_tokenizer();
+    bench_expansion();
+    bench_builtin_dispatch();
+    bench_spawn();
+    bench_script(shell);
+    bench_prompt();
+    bench_startup(shell);
+
+    write_metrics(stdout);
+
+    if (output_path != NULL)
+    {
+        FILE *output = fopen(output_path, "w");
+        if (output == NULL)
+        {
+            perror("josh_bench: output");
+            return 2;
+        }
+        write_metrics(output);
+        fclose(output);
+    }
+
+    if (baseline_path != NULL)
+    {
+        int regressions = compare_metrics(baseline_path, threshold_percent);
+        if (regressions < 0)
+        {
+            // Nothing was compared, which must not pass for "no regression"
+            return 2;
+        }
+        if (regressions > 0)
+        {
+            fprintf(stderr, "josh_bench: %d regression(s) over %.1f%%\n", regressions, threshold_percent);
+            return 1;
+        }
+    }
+
+    return 0;
+}
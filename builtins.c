@@ -1,12 +1,24 @@
 #include "builtins.h"
+#include "cache.h" // For cache_run
 #include "command.h"
 #include "config.h"
+#include "coproc.h"       // For coproc_start, coproc_write_line, coproc_read_line
+#include "frecency.h"     // For frecency_record, frecency_query
+#include "io.h"           // For io_printf, io_flush
 #include "path.h"
-#include <stdint.h> // For uint8_t
-#include <stdio.h>  // For printf, fflush, stdout
-#include <stdlib.h> // For exit
-#include <string.h> // For strcmp
-#include <unistd.h> // For chdir
+#include "process.h"      // For exec_process
+#include "timing.h"       // For timing_phase_snapshot
+#include "trace.h"        // For trace_start, trace_stop, trace_flush
+#include <ctype.h>        // For isdigit
+#include <fcntl.h>        // For open
+#include <linux/limits.h> // For PATH_MAX
+#include <signal.h>       // For SIGTERM, SIGKILL, ...
+#include <stdint.h>       // For uint8_t
+#include <stdio.h>        // For printf, fflush, stdout
+#include <stdlib.h>       // For exit
+#include <string.h>       // For strcmp
+#include <sys/resource.h> // For getrusage
+#include <unistd.h>       // For chdir
 
 // This struct is an IMPLEMENTATION DETAIL of how we look up built-ins.
 // It is only used inside this file, so it is defined here and nowhere else.
@@ -16,6 +28,9 @@ typedef struct
     char *string;              // string that represents the command, e.g. "exit"
     CommandFunction *function; // function that the command should execute
     char *short_help;          // short string with basic help of the command
+    bool mutates_shell_state;  // whether it changes the state of the shell
+                               // process (cwd, fds, exit...), in which case it
+                               // can't run on a thread of a pipeline
 } BuiltinCommand;
 
 // =================================================================
@@ -43,29 +58,26 @@ int get_builtin_command_index(const char *command);
  *                      Expected: 0 or 1.
  * @param argv          Array of argument strings. If argc >= 1, argv[0] should
  *                      be an integer string.
- * @param output_buffer A buffer provided by the caller where this function can
- *                      write its text output.
- * @param buffer_size   The total size in bytes of the output_buffer. Used to
- *                      prevent buffer overflows.
+ * @param io            The streams of the command, its output goes there.
  *
  * @return Exit status to be passed to the OS.
  */
-static CommandResult builtin_exit(int argc, char *argv[], char *output_buffer, size_t buffer_size);
+static CommandResult builtin_exit(int argc, char *argv[], CommandIO *io);
 
 /**
- * @brief Changes the working directory of the shell
+ * @brief Changes the working directory of the shell. Every directory changed
+ *  to is recorded in the frecency database, and `cd -j KEYWORD...` jumps to the
+ *  best ranked directory matching the keywords (see frecency.h).
  *
- * @param argc          Number of arguments passed to the command. Expected: 1.
+ * @param argc          Number of arguments passed to the command. Expected: 1,
+ *                      or more after -j.
  * @param argv          Array of argument strings. argv[0] should be a valid
- *                      Path variable.
- * @param output_buffer A buffer provided by the caller where this function can
- *                      write its text output.
- * @param buffer_size   The total size in bytes of the output_buffer. Used to
- *                      prevent buffer overflows.
+ *                      Path variable, or -j followed by the keywords.
+ * @param io            The streams of the command, its output goes there.
  *
  * @return
  */
-static CommandResult builtin_cd(int argc, char *argv[], char *output_buffer, size_t buffer_size);
+static CommandResult builtin_cd(int argc, char *argv[], CommandIO *io);
 
 /**
  * @brief
@@ -73,25 +85,237 @@ static CommandResult builtin_cd(int argc, char *argv[], char *output_buffer, siz
  * @param argc          Number of arguments passed to the command. Expected: 1.
  * @param argv          Array of argument strings. argv[0] should be a valid
  *                      Path variable.
- * @param output_buffer A buffer provided by the caller where this function can
- *                      write its text output.
- * @param buffer_size   The total size in bytes of the output_buffer. Used to
- *                      prevent buffer overflows.
+ * @param io            The streams of the command, its output goes there.
  *
  * @return
  */
-static CommandResult builtin_help(int argc, char *argv[], char *output_buffer, size_t buffer_size);
+static CommandResult builtin_help(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Prints the accumulated user and system times of the shell and of all
+ *  its (already reaped) children. With -v the shell overhead accumulated in
+ *  each phase (parse, lookup, spawn, wait, builtin) is printed as well.
+ *
+ * @param argc          Number of arguments passed to the command.
+ *                      Expected: 0 or 1.
+ * @param argv          Array of argument strings. If argc >= 1, argv[0] may
+ *                      be "-v".
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return 0 on success, 1 on invalid arguments.
+ */
+static CommandResult builtin_times(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Controls the tracing of the shell internals (see trace.h).
+ *
+ *  trace on FILE   Start recording events, written to FILE
+ *  trace off       Flush the pending events and stop recording
+ *  trace flush     Write the pending events to the trace file now
+ *
+ * @param argc          Number of arguments passed to the command.
+ *                      Expected: 1 or 2.
+ * @param argv          Array of argument strings. argv[0] is the action.
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static CommandResult builtin_trace(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Runs an external command through the output cache (see cache.h).
+ *
+ *  cache [--ttl SECONDS] [--dep FILE]... [--env VAR]... [--] command [args]
+ *  cache --stats
+ *  cache --clear
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings: options, then the command.
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return The exit status of the (possibly replayed) command, or 1 on invalid
+ *         arguments.
+ */
+static CommandResult builtin_cache(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Replaces the shell with an external command, without forking. With
+ *  only redirections and no command, the redirections are applied to the shell
+ *  itself and stay in effect for the rest of the session.
+ *
+ *  exec [redirection]... [command [args]]
+ *
+ * Supported redirections: [N]>FILE, [N]>>FILE, [N]<FILE, [N]>&M, [N]<&M and
+ * [N]>&- (close). The target may also be given as a separate word.
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings: redirections, then the
+ *                      command.
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return 0 after applying only redirections, 1 on failure. It does not
+ *         return if the command is executed.
+ */
+static CommandResult builtin_exec(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Applies the redirection at the start of argv to the shell process.
+ *
+ * @param argc Number of words left in argv.
+ * @param argv Words, the first one is checked for a redirection.
+ * @return Number of words that made up the redirection (1 or 2), 0 if argv[0]
+ *         is not a redirection, or -1 if it could not be applied.
+ */
+static int apply_redirection(int argc, char *argv[]);
+
+/**
+ * @brief Runs an external command with a time limit. When it expires the
+ *  command gets SIGNAL (TERM by default) and, if it is still alive KILL_AFTER
+ *  later (5s by default, 0 to never escalate), SIGKILL.
+ *
+ *  timeout [-s SIGNAL] [-k KILL_AFTER] DURATION command [args]
+ *
+ * Durations are seconds, optionally followed by s, m, h or d. The command may
+ * itself start with `limit`, to combine both prefixes in one launch.
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings: options, duration, command.
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return The exit status of the command, 124 if it timed out, 137 if it had
+ *         to be killed, 125 on invalid arguments.
+ */
+static CommandResult builtin_timeout(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Runs an external command with resource limits, applied in the child
+ *  before exec.
+ *
+ *  limit [--cpu SECONDS] [--as BYTES] [--nofile COUNT] command [args]
+ *
+ * BYTES accept a K, M or G suffix. The command may itself start with
+ * `timeout`, to combine both prefixes in one launch.
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings: options, then the command.
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return The exit status of the command, 125 on invalid arguments.
+ */
+static CommandResult builtin_limit(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Runs the command that follows a chain of `timeout`/`limit` prefixes,
+ *  with the options of all of them applied.
+ *
+ * @param prefix Name of the first prefix ("timeout" or "limit").
+ * @param argc   Number of words after the first prefix.
+ * @param argv   Words after the first prefix.
+ * @param io     The streams the command is run with.
+ * @return The exit status of the command, 125 on invalid arguments.
+ */
+static CommandResult run_prefixed_command(const char *prefix, int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Shorthand for `cd -j KEYWORD...`. Without keywords, lists the
+ *  directories of the frecency database with their scores.
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings, the keywords.
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return 0 on success, 1 if no directory matched or it couldn't be entered.
+ */
+static CommandResult builtin_jump(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Writes its arguments, separated by spaces and followed by a newline,
+ *  to the output.
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings. If argv[0] is "-n", no
+ *                      newline is written at the end.
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return 0 on success, 1 if the output could not be written.
+ */
+static CommandResult builtin_echo(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Starts a coprocess, or lists the running ones when called without
+ *  arguments.
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings: the name of the coprocess,
+ *                      then the external command to run and its arguments.
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return 0 on success, 1 on failure, 2 on invalid arguments.
+ */
+static CommandResult builtin_coproc(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Writes a line (the words after the name, separated by spaces) to the
+ *  stdin of a coprocess. With `-` instead of the words, writes everything read
+ *  from its input instead (`seq 10 | cowrite calc -`).
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings: NAME [WORD]... or NAME -
+ * @param io            The streams of the command, the input is read from
+ *                      there with `-`.
+ *
+ * @return 0 on success, 1 on failure, 2 on invalid arguments.
+ */
+static CommandResult builtin_cowrite(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Reads one line from the stdout of a coprocess and writes it to the
+ *  output.
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings: NAME
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return 0 on success, 1 at the end of its output, 2 on invalid arguments.
+ */
+static CommandResult builtin_coread(int argc, char *argv[], CommandIO *io);
+
+/**
+ * @brief Closes the stdin of a coprocess and waits for it to exit.
+ *
+ * @param argc          Number of arguments passed to the command.
+ * @param argv          Array of argument strings: NAME
+ * @param io            The streams of the command, its output goes there.
+ *
+ * @return Exit status of the coprocess, 2 on invalid arguments.
+ */
+static CommandResult builtin_coclose(int argc, char *argv[], CommandIO *io);
 
 // The constant array is the core data of this module. It is private.
 // It is the lookup table for this module's logic. 'static' ensures it's not
 // visible to the linker from other files.
 static const BuiltinCommand BUILTIN_COMMANDS[] = {
-    {"exit", &builtin_exit, "Exit the shell"},
-    {"cd", &builtin_cd, "Change directory"},
-    {"help", &builtin_help, "Show help about available commands"},
-    {NULL, NULL, NULL} // Use a NULL sentinel for robust iteration.
+    {"exit", &builtin_exit, "Exit the shell", true},
+    {"cd", &builtin_cd, "Change directory (-j KEYWORD... to jump to a visited one)", true},
+    {"j", &builtin_jump, "Jump to the best visited directory matching the keywords", true},
+    {"help", &builtin_help, "Show help about available commands", false},
+    {"echo", &builtin_echo, "Write the arguments to the output (-n: no newline)", false},
+    {"exec", &builtin_exec, "Replace the shell with a command, or redirect the shell's fds", true},
+    {"timeout", &builtin_timeout, "Run a command with a time limit", false},
+    {"limit", &builtin_limit, "Run a command with resource limits (cpu, as, nofile)", false},
+    {"cache", &builtin_cache, "Run a command replaying its cached output if possible", false},
+    {"times", &builtin_times, "Show accumulated shell and children times", false},
+    {"trace", &builtin_trace, "Record a Chrome trace of the shell (on FILE|off|flush)", true},
+    {"coproc", &builtin_coproc, "Start a helper process once (coproc NAME command), list them", true},
+    {"cowrite", &builtin_cowrite, "Write a line, or its input, to a coprocess (cowrite NAME words...|-)", false},
+    {"coread", &builtin_coread, "Read a line from a coprocess (coread NAME)", false},
+    {"coclose", &builtin_coclose, "Close the input of a coprocess and wait for it", true},
+    {NULL, NULL, NULL, false} // Use a NULL sentinel for robust iteration.
 };
 
+// Set in the forked copies of the shell, see builtin_enter_subshell
+static bool in_subshell = false;
+
 // =================================================================
 // Definitions: Public functions
 // =================================================================
@@ -101,7 +325,14 @@ bool builtin_exists(const char *command_name)
     return (get_builtin_command_index(command_name) != -1);
 }
 
-CommandResult builtin_execute(const ParsedInput *parsed_command, char *output_buffer, size_t buffer_size)
+bool builtin_mutates_state(const char *command_name)
+{
+    int builtin_command_index = get_builtin_command_index(command_name);
+
+    return builtin_command_index != -1 && BUILTIN_COMMANDS[builtin_command_index].mutates_shell_state;
+}
+
+CommandResult builtin_execute(const ParsedInput *parsed_command, CommandIO *io)
 {
     const char *command_name = parsed_command->arguments[0];
     int builtin_command_index = get_builtin_command_index(command_name);
@@ -111,10 +342,21 @@ CommandResult builtin_execute(const ParsedInput *parsed_command, char *output_bu
     int arguments_count = parsed_command->count - 1;
     char **command_arguments = parsed_command->arguments + 1;
 
-    int exit_status = function_to_call(arguments_count, command_arguments, NULL, 0);
+    // Whatever the shell printed before must come out before the builtin's
+    // output, which does not go through stdio
+    fflush(stdout);
+
+    int exit_status = function_to_call(arguments_count, command_arguments, io);
+    io_flush(io);
+
     return exit_status;
 }
 
+void builtin_enter_subshell(void)
+{
+    in_subshell = true;
+}
+
 CommandResult builtin_execute_empty(void)
 {
     // printf("");
@@ -142,7 +384,7 @@ int get_builtin_command_index(const char *command_name)
     return index;
 }
 
-CommandResult builtin_exit(int argc, char *argv[], char *output_buffer, size_t buffer_size)
+CommandResult builtin_exit(int argc, char *argv[], CommandIO *io)
 {
     uint8_t exit_code = 0;
 
@@ -151,17 +393,46 @@ CommandResult builtin_exit(int argc, char *argv[], char *output_buffer, size_t b
         exit_code = atoi(argv[0]);
     }
 
-    printf("%s\n", EXIT_MESSAGE);
+    // Only the copy ends, the shell goes on
+    if (in_subshell)
+    {
+        return exit_code;
+    }
+
+    io_printf(io, "%s\n", EXIT_MESSAGE);
+    io_flush(io);
+    // The shell never returns from this builtin to record its end event, and
+    // the trace is written by the exit handlers
+    trace_end("exit");
     exit(exit_code);
 }
 
-CommandResult builtin_cd(int argc, char *argv[], char *output_buffer, size_t buffer_size)
+CommandResult builtin_cd(int argc, char *argv[], CommandIO *io)
 {
+    (void)io; // cd writes nothing
+
     char *path_to_change_to = NULL;
+    char jump_target[PATH_MAX];
 
     // --- Step 1: Determine the target directory ---
 
-    if (argc == 0)
+    if (argc >= 1 && !strcmp(argv[0], "-j"))
+    {
+        // Case: User typed "cd -j keywords...". Look them up in the frecency
+        // database of visited directories.
+        if (argc == 1)
+        {
+            fprintf(stderr, "myshell: cd: -j: keywords expected\n");
+            return 1;
+        }
+        if (!frecency_query(argv + 1, argc - 1, jump_target, sizeof(jump_target)))
+        {
+            fprintf(stderr, "myshell: cd: -j: no match found\n");
+            return 1;
+        }
+        path_to_change_to = jump_target;
+    }
+    else if (argc == 0)
     {
         // Case: User typed just "cd". We need to go to the HOME directory.
         path_to_change_to = getenv("HOME");
@@ -207,6 +478,10 @@ CommandResult builtin_cd(int argc, char *argv[], char *output_buffer, size_t buf
         perror("myshell: cd, updating PWD");
         return 1; // Return failure
     }
+
+    // Remember the visit, to be able to jump back here later
+    frecency_record(path_get_raw(cwd));
+
     // Destroy the path we created, memory leak if this is skipped
     path_destroy(cwd);
 
@@ -214,20 +489,736 @@ CommandResult builtin_cd(int argc, char *argv[], char *output_buffer, size_t buf
     return 0;
 }
 
-CommandResult builtin_help(int argc, char *argv[], char *output_buffer, size_t buffer_size)
+CommandResult builtin_help(int argc, char *argv[], CommandIO *io)
+{
+    (void)argc; // help takes no arguments
+    (void)argv;
+
+    io_printf(io, "Commands available:\n");
+
+    // Stop at the NULL sentinel
+    for (const BuiltinCommand *current_command_ptr = BUILTIN_COMMANDS; current_command_ptr->string != NULL;
+         current_command_ptr++)
+    {
+        io_printf(io, " - %s    %s\n", current_command_ptr->string, current_command_ptr->short_help);
+    }
+
+    return 0;
+}
+
+CommandResult builtin_times(int argc, char *argv[], CommandIO *io)
 {
-    printf("Commands available:\n");
-    BuiltinCommand *current_command_ptr = (BuiltinCommand *)BUILTIN_COMMANDS;
+    bool verbose = false;
+
+    if (argc == 1 && !strcmp(argv[0], "-v"))
+    {
+        verbose = true;
+    }
+    else if (argc > 0)
+    {
+        fprintf(stderr, "myshell: times: usage: times [-v]\n");
+        return 1;
+    }
+
+    struct rusage self;
+    struct rusage children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
 
-    const size_t number_builtin_commands = sizeof(BUILTIN_COMMANDS) / sizeof(BUILTIN_COMMANDS[0]);
+    // Same layout as the POSIX `times`: first line the shell, second line its
+    // children, user time followed by system time.
+    io_printf(io, "%ldm%ld.%06lds %ldm%ld.%06lds\n", (long)self.ru_utime.tv_sec / 60,
+              (long)self.ru_utime.tv_sec % 60, (long)self.ru_utime.tv_usec, (long)self.ru_stime.tv_sec / 60,
+              (long)self.ru_stime.tv_sec % 60, (long)self.ru_stime.tv_usec);
+    io_printf(io, "%ldm%ld.%06lds %ldm%ld.%06lds\n", (long)children.ru_utime.tv_sec / 60,
+              (long)children.ru_utime.tv_sec % 60, (long)children.ru_utime.tv_usec,
+              (long)children.ru_stime.tv_sec / 60, (long)children.ru_stime.tv_sec % 60,
+              (long)children.ru_stime.tv_usec);
 
-    for (int i = 0; i < number_builtin_commands; i++)
+    if (verbose)
     {
-        printf(" - %s    %s\n", current_command_ptr->string, current_command_ptr->short_help);
+        double phases[TIMING_PHASE_COUNT];
+        timing_phase_snapshot(phases);
 
-        // Advance by one element
-        current_command_ptr = current_command_ptr + 1;
+        io_printf(io, "phases:\n");
+        for (int phase = 0; phase < TIMING_PHASE_COUNT; phase++)
+        {
+            io_printf(io, "  %-8s %.6fs\n", timing_phase_name(phase), phases[phase]);
+        }
     }
 
     return 0;
 }
+
+CommandResult builtin_trace(int argc, char *argv[], CommandIO *io)
+{
+    (void)io; // trace writes nothing
+
+    // The shell records a begin and an end event around every builtin, this
+    // one included. The file being closed gets the end of the event its begin
+    // opened, the file being started gets the begin of the end to come.
+    if (argc == 2 && !strcmp(argv[0], "on"))
+    {
+        trace_end("trace");
+        if (!trace_start(argv[1]))
+        {
+            perror("myshell: trace");
+            return 1;
+        }
+        trace_begin("trace");
+        return 0;
+    }
+
+    if (argc == 1 && !strcmp(argv[0], "off"))
+    {
+        trace_end("trace");
+        trace_stop();
+        return 0;
+    }
+
+    if (argc == 1 && !strcmp(argv[0], "flush"))
+    {
+        trace_flush();
+        return 0;
+    }
+
+    fprintf(stderr, "myshell: trace: usage: trace on FILE | trace off | trace flush\n");
+    return 1;
+}
+
+CommandResult builtin_cache(int argc, char *argv[], CommandIO *io)
+{
+    if (argc == 1 && !strcmp(argv[0], "--stats"))
+    {
+        return cache_print_stats(io);
+    }
+
+    if (argc == 1 && !strcmp(argv[0], "--clear"))
+    {
+        return cache_clear();
+    }
+
+    // There can't be more dependencies or variables than arguments
+    CacheRequest request = {
+        .ttl_seconds = 0,
+        .dependencies = malloc(sizeof(char *) * (argc + 1)),
+        .dependency_count = 0,
+        .environment = malloc(sizeof(char *) * (argc + 1)),
+        .environment_count = 0,
+    };
+
+    if (request.dependencies == NULL || request.environment == NULL)
+    {
+        free(request.dependencies);
+        free(request.environment);
+        perror("myshell: cache");
+        return 1;
+    }
+
+    CommandResult result = 1;
+    int i = 0;
+    bool valid = true;
+
+    for (; i < argc && valid && argv[i][0] == '-'; i++)
+    {
+        if (!strcmp(argv[i], "--"))
+        {
+            i++;
+            break;
+        }
+        else if (!strcmp(argv[i], "--ttl") && i + 1 < argc)
+        {
+            char *end = NULL;
+            request.ttl_seconds = strtod(argv[++i], &end);
+            valid = *end == '\0' && request.ttl_seconds >= 0;
+        }
+        else if (!strcmp(argv[i], "--dep") && i + 1 < argc)
+        {
+            request.dependencies[request.dependency_count++] = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--env") && i + 1 < argc)
+        {
+            request.environment[request.environment_count++] = argv[++i];
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+
+    if (!valid || i >= argc)
+    {
+        fprintf(stderr, "myshell: cache: usage: cache [--ttl SECONDS] [--dep FILE]... [--env VAR]... command [args]\n"
+                        "                     cache --stats | cache --clear\n");
+    }
+    else if (builtin_exists(argv[i]))
+    {
+        fprintf(stderr, "myshell: cache: %s: only external commands can be cached\n", argv[i]);
+    }
+    else
+    {
+        // argv is NULL-terminated, so its tail is a valid argument array
+        ParsedInput command = {
+            .count = argc - i,
+            .arguments = argv + i,
+        };
+        result = cache_run(&command, &request, io);
+    }
+
+    free(request.dependencies);
+    free(request.environment);
+
+    return result;
+}
+
+int apply_redirection(int argc, char *argv[])
+{
+    const char *word = argv[0];
+    int fd = -1; // File descriptor being redirected, -1 for the default one
+
+    if (isdigit((unsigned char)word[0]))
+    {
+        fd = 0;
+        for (; isdigit((unsigned char)*word); word++)
+        {
+            fd = fd * 10 + (*word - '0');
+        }
+    }
+
+    // Longest operators first, ">" is a prefix of ">>" and ">&"
+    static const char *OPERATORS[] = {">>", ">&", "<&", ">", "<", NULL};
+    const char *operator = NULL;
+    for (int i = 0; OPERATORS[i] != NULL && operator == NULL; i++)
+    {
+        if (!strncmp(word, OPERATORS[i], strlen(OPERATORS[i])))
+        {
+            operator = OPERATORS[i];
+        }
+    }
+
+    if (operator == NULL)
+    {
+        return 0; // Just a word (e.g. the command, or a file named "2")
+    }
+
+    if (fd == -1)
+    {
+        fd = operator[0] == '<' ? STDIN_FILENO : STDOUT_FILENO;
+    }
+
+    // The target goes right after the operator, or in the next word
+    const char *target = word + strlen(operator);
+    int consumed = 1;
+    if (*target == '\0')
+    {
+        if (argc < 2)
+        {
+            fprintf(stderr, "myshell: exec: %s: missing redirection target\n", argv[0]);
+            return -1;
+        }
+        target = argv[1];
+        consumed = 2;
+    }
+
+    // Whatever the shell buffered must go to the old destination
+    fflush(stdout);
+    fflush(stderr);
+
+    int target_fd = -1;
+    if (operator[1] == '&')
+    {
+        if (!strcmp(target, "-"))
+        {
+            close(fd);
+            return consumed;
+        }
+
+        char *end = NULL;
+        target_fd = (int)strtol(target, &end, 10);
+        if (*end != '\0' || dup2(target_fd, fd) == -1)
+        {
+            fprintf(stderr, "myshell: exec: %s: bad file descriptor\n", target);
+            return -1;
+        }
+        return consumed;
+    }
+
+    if (!strcmp(operator, ">>"))
+    {
+        target_fd = open(target, O_WRONLY | O_CREAT | O_APPEND, 0666);
+    }
+    else if (!strcmp(operator, ">"))
+    {
+        target_fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+    else
+    {
+        target_fd = open(target, O_RDONLY);
+    }
+
+    if (target_fd == -1)
+    {
+        fprintf(stderr, "myshell: exec: %s: ", target);
+        perror(NULL);
+        return -1;
+    }
+
+    if (target_fd != fd)
+    {
+        int duplicated = dup2(target_fd, fd);
+        close(target_fd);
+
+        if (duplicated == -1)
+        {
+            perror("myshell: exec");
+            return -1;
+        }
+    }
+
+    return consumed;
+}
+
+CommandResult builtin_exec(int argc, char *argv[], CommandIO *io)
+{
+    int i = 0;
+
+    while (i < argc)
+    {
+        int consumed = apply_redirection(argc - i, argv + i);
+        if (consumed < 0)
+        {
+            return 1;
+        }
+        if (consumed == 0)
+        {
+            break; // The command starts here
+        }
+        i += consumed;
+    }
+
+    if (i == argc)
+    {
+        return 0; // Only redirections, they stay applied to the shell
+    }
+
+    if (builtin_exists(argv[i]))
+    {
+        fprintf(stderr, "myshell: exec: %s: not an external command\n", argv[i]);
+        return 1;
+    }
+
+    // The shell is about to be replaced, nothing would flush the trace later
+    trace_flush();
+
+    // The command takes over the streams of the builtin (they differ from the
+    // shell's when exec is a stage of a pipeline)
+    io_flush(io);
+    if ((io->input_fd != STDIN_FILENO && dup2(io->input_fd, STDIN_FILENO) == -1) ||
+        (io->output_fd != STDOUT_FILENO && dup2(io->output_fd, STDOUT_FILENO) == -1))
+    {
+        perror("myshell: exec");
+        return 1;
+    }
+
+    // argv is NULL-terminated, so its tail is a valid argument array
+    ParsedInput command = {
+        .count = argc - i,
+        .arguments = argv + i,
+    };
+
+    return exec_process(&command);
+}
+
+// Exit status of `timeout` and `limit` when they can't run the command
+static const CommandResult PREFIX_USAGE_STATUS = 125;
+
+// Time given to a command to exit after the timeout signal, before SIGKILL
+static const double DEFAULT_KILL_AFTER_SECONDS = 5;
+
+/**
+ * @brief Parses a duration: a number of seconds, optionally followed by s, m,
+ *  h or d.
+ *
+ * @return true if the whole string is a valid, non negative, duration.
+ */
+static bool parse_duration(const char *text, double *seconds)
+{
+    char *end = NULL;
+    double value = strtod(text, &end);
+
+    if (end == text || value < 0)
+    {
+        return false;
+    }
+
+    double multiplier = 1;
+    if (*end != '\0')
+    {
+        static const char *UNITS = "smhd";
+        static const double MULTIPLIERS[] = {1, 60, 3600, 86400};
+        const char *unit = strchr(UNITS, *end);
+
+        if (unit == NULL || end[1] != '\0')
+        {
+            return false;
+        }
+        multiplier = MULTIPLIERS[unit - UNITS];
+    }
+
+    *seconds = value * multiplier;
+    return true;
+}
+
+/**
+ * @brief Parses a signal given by name (with or without SIG) or number.
+ *
+ * @return The signal number, or -1 if it is not known.
+ */
+static int parse_signal(const char *text)
+{
+    static const struct
+    {
+        const char *name;
+        int number;
+    } SIGNALS[] = {
+        {"HUP", SIGHUP},   {"INT", SIGINT},   {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+        {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"ALRM", SIGALRM}, {"TERM", SIGTERM},
+    };
+
+    char *end = NULL;
+    long number = strtol(text, &end, 10);
+    if (end != text && *end == '\0')
+    {
+        return number > 0 && number < NSIG ? (int)number : -1;
+    }
+
+    if (!strncmp(text, "SIG", 3))
+    {
+        text += 3;
+    }
+
+    for (size_t i = 0; i < sizeof(SIGNALS) / sizeof(SIGNALS[0]); i++)
+    {
+        if (!strcmp(text, SIGNALS[i].name))
+        {
+            return SIGNALS[i].number;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Parses an amount of bytes, optionally followed by K, M or G.
+ *
+ * @return true if the whole string is a valid amount.
+ */
+static bool parse_bytes(const char *text, rlim_t *bytes)
+{
+    char *end = NULL;
+    unsigned long long value = strtoull(text, &end, 10);
+
+    if (end == text || text[0] == '-')
+    {
+        return false;
+    }
+
+    switch (*end)
+    {
+    case 'G':
+        value *= 1024;
+        // fall through
+    case 'M':
+        value *= 1024;
+        // fall through
+    case 'K':
+        value *= 1024;
+        end++;
+        break;
+    default:
+        break;
+    }
+
+    *bytes = (rlim_t)value;
+    return *end == '\0';
+}
+
+/**
+ * @brief Parses the options and the duration of `timeout`.
+ *
+ * @return Number of words consumed, or -1 if they are not valid.
+ */
+static int parse_timeout_options(int argc, char *argv[], LaunchOptions *options)
+{
+    int i = 0;
+    options->kill_after_seconds = DEFAULT_KILL_AFTER_SECONDS;
+
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2)
+    {
+        if (!strcmp(argv[i], "-s"))
+        {
+            options->timeout_signal = parse_signal(argv[i + 1]);
+            if (options->timeout_signal == -1)
+            {
+                fprintf(stderr, "myshell: timeout: %s: unknown signal\n", argv[i + 1]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[i], "-k"))
+        {
+            if (!parse_duration(argv[i + 1], &options->kill_after_seconds))
+            {
+                fprintf(stderr, "myshell: timeout: %s: invalid duration\n", argv[i + 1]);
+                return -1;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (i >= argc || !parse_duration(argv[i], &options->timeout_seconds))
+    {
+        fprintf(stderr, "myshell: timeout: usage: timeout [-s SIGNAL] [-k KILL_AFTER] DURATION command [args]\n");
+        return -1;
+    }
+
+    return i + 1;
+}
+
+/**
+ * @brief Parses the options of `limit`.
+ *
+ * @return Number of words consumed, or -1 if they are not valid.
+ */
+static int parse_limit_options(int argc, char *argv[], LaunchOptions *options)
+{
+    int i = 0;
+
+    for (; i + 1 < argc && !strncmp(argv[i], "--", 2); i += 2)
+    {
+        if (options->limit_count >= LAUNCH_MAX_LIMITS)
+        {
+            fprintf(stderr, "myshell: limit: too many limits\n");
+            return -1;
+        }
+
+        LaunchLimit *limit = &options->limits[options->limit_count];
+        bool valid = true;
+
+        if (!strcmp(argv[i], "--cpu"))
+        {
+            double seconds = 0;
+            limit->resource = RLIMIT_CPU;
+            valid = parse_duration(argv[i + 1], &seconds) && seconds >= 1;
+            limit->value = (rlim_t)seconds;
+        }
+        else if (!strcmp(argv[i], "--as"))
+        {
+            limit->resource = RLIMIT_AS;
+            valid = parse_bytes(argv[i + 1], &limit->value);
+        }
+        else if (!strcmp(argv[i], "--nofile"))
+        {
+            limit->resource = RLIMIT_NOFILE;
+            valid = parse_bytes(argv[i + 1], &limit->value);
+        }
+        else
+        {
+            fprintf(stderr, "myshell: limit: %s: unknown limit\n", argv[i]);
+            return -1;
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "myshell: limit: %s: invalid value '%s'\n", argv[i], argv[i + 1]);
+            return -1;
+        }
+
+        options->limit_count++;
+    }
+
+    if (i == 0)
+    {
+        fprintf(stderr, "myshell: limit: usage: limit [--cpu SECONDS] [--as BYTES] [--nofile COUNT] command [args]\n");
+        return -1;
+    }
+
+    return i;
+}
+
+CommandResult run_prefixed_command(const char *prefix, int argc, char *argv[], CommandIO *io)
+{
+    LaunchOptions options = launch_options_default();
+    options.stdin_fd = io->input_fd;
+    options.stdout_fd = io->output_fd;
+    int i = 0;
+
+    while (prefix != NULL)
+    {
+        int consumed = !strcmp(prefix, "timeout") ? parse_timeout_options(argc - i, argv + i, &options)
+                                                  : parse_limit_options(argc - i, argv + i, &options);
+        if (consumed < 0)
+        {
+            return PREFIX_USAGE_STATUS;
+        }
+        i += consumed;
+
+        // Chained prefixes (`timeout 5 limit --cpu 2 cmd`) add up their options
+        prefix = NULL;
+        if (i < argc && (!strcmp(argv[i], "timeout") || !strcmp(argv[i], "limit")))
+        {
+            prefix = argv[i++];
+        }
+    }
+
+    if (i >= argc)
+    {
+        fprintf(stderr, "myshell: missing command\n");
+        return PREFIX_USAGE_STATUS;
+    }
+
+    if (builtin_exists(argv[i]))
+    {
+        fprintf(stderr, "myshell: %s: only external commands can be limited\n", argv[i]);
+        return PREFIX_USAGE_STATUS;
+    }
+
+    // argv is NULL-terminated, so its tail is a valid argument array
+    ParsedInput command = {
+        .count = argc - i,
+        .arguments = argv + i,
+    };
+
+    io_flush(io);
+    return launch_process_with_options(&command, &options, NULL);
+}
+
+CommandResult builtin_timeout(int argc, char *argv[], CommandIO *io)
+{
+    return run_prefixed_command("timeout", argc, argv, io);
+}
+
+CommandResult builtin_limit(int argc, char *argv[], CommandIO *io)
+{
+    return run_prefixed_command("limit", argc, argv, io);
+}
+
+CommandResult builtin_jump(int argc, char *argv[], CommandIO *io)
+{
+    if (argc == 0)
+    {
+        frecency_print(io);
+        return 0;
+    }
+
+    // Same as `cd -j keywords...`
+    char *cd_arguments[argc + 2];
+    cd_arguments[0] = "-j";
+    memcpy(cd_arguments + 1, argv, sizeof(char *) * argc);
+    cd_arguments[argc + 1] = NULL;
+
+    return builtin_cd(argc + 1, cd_arguments, io);
+}
+
+CommandResult builtin_echo(int argc, char *argv[], CommandIO *io)
+{
+    bool newline = true;
+    int first = 0;
+
+    if (argc > 0 && !strcmp(argv[0], "-n"))
+    {
+        newline = false;
+        first = 1;
+    }
+
+    for (int i = first; i < argc; i++)
+    {
+        if (i > first)
+        {
+            io_write(io, " ", 1);
+        }
+        io_write(io, argv[i], strlen(argv[i]));
+    }
+
+    if (newline)
+    {
+        io_write(io, "\n", 1);
+    }
+
+    return io_flush(io) ? 0 : 1;
+}
+
+// Exit status of the coprocess builtins on invalid arguments
+static const CommandResult COPROC_USAGE_STATUS = 2;
+
+CommandResult builtin_coproc(int argc, char *argv[], CommandIO *io)
+{
+    if (argc == 0)
+    {
+        coproc_print(io);
+        return 0;
+    }
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "myshell: coproc: usage: coproc NAME command [args]\n");
+        return COPROC_USAGE_STATUS;
+    }
+
+    if (builtin_exists(argv[1]))
+    {
+        fprintf(stderr, "myshell: coproc: %s: only external commands can be coprocesses\n", argv[1]);
+        return 1;
+    }
+
+    // argv is NULL-terminated, so its tail is a valid argument array
+    ParsedInput command = {
+        .count = argc - 1,
+        .arguments = argv + 1,
+    };
+
+    return coproc_start(argv[0], &command);
+}
+
+CommandResult builtin_cowrite(int argc, char *argv[], CommandIO *io)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "myshell: cowrite: usage: cowrite NAME [word]... | cowrite NAME -\n");
+        return COPROC_USAGE_STATUS;
+    }
+
+    // The input streams to the coprocess, as it is produced upstream
+    if (argc == 2 && !strcmp(argv[1], "-"))
+    {
+        return coproc_write_input(argv[0], io->input_fd);
+    }
+
+    return coproc_write_line(argv[0], argc - 1, argv + 1);
+}
+
+CommandResult builtin_coread(int argc, char *argv[], CommandIO *io)
+{
+    if (argc != 1)
+    {
+        fprintf(stderr, "myshell: coread: usage: coread NAME\n");
+        return COPROC_USAGE_STATUS;
+    }
+
+    return coproc_read_line(argv[0], io);
+}
+
+CommandResult builtin_coclose(int argc, char *argv[], CommandIO *io)
+{
+    (void)io; // coclose writes nothing
+
+    if (argc != 1)
+    {
+        fprintf(stderr, "myshell: coclose: usage: coclose NAME\n");
+        return COPROC_USAGE_STATUS;
+    }
+
+    return coproc_close(argv[0]);
+}
@@ -1,4 +1,5 @@
 #ifndef MYSHELL_BUILTINS_H
+#define MYSHELL_BUILTINS_H
 
 #include "command.h" // For CommandResult
 #include <stdbool.h> // For bool
@@ -18,14 +19,34 @@
 bool builtin_exists(const char *command_name);
 
 /**
- * @brief Execute a builtin command
+ * @brief Check whether a builtin changes the state of the shell process (its
+ *  working directory, file descriptors, tracing, or whether it keeps running).
+ *  Such builtins can't run on a thread next to the shell, e.g. as a stage of a
+ *  pipeline.
+ *
+ * @param command_name Command to check
+ * @return true if the command is a builtin that mutates the shell state
+ */
+bool builtin_mutates_state(const char *command_name);
+
+/**
+ * @brief Execute a builtin command. It is safe to call from several threads at
+ *  once as long as each call gets its own CommandIO and the builtins don't
+ *  mutate the shell state (see builtin_mutates_state).
  *
  * @param parsed_command ParsedInput of the command to execute
- * @param argc Number of arguments to the command
- * @param argv Array of arguments to the command
+ * @param io Streams of the command. The output is flushed before returning.
  * @return CommandResult Result of the command execution
  */
-CommandResult builtin_execute(const ParsedInput *parsed_command, char *output_buffer, size_t buffer_size);
+CommandResult builtin_execute(const ParsedInput *parsed_command, CommandIO *io);
+
+/**
+ * @brief Tell the builtins that they run in a forked copy of the shell, e.g. a
+ *  stage of a pipeline. `exit` then returns its status instead of exiting:
+ *  the copy must leave with _exit, as exit() would run the atexit handlers of
+ *  the shell and flush the stdio buffers it shares with it.
+ */
+void builtin_enter_subshell(void);
 
 /**
  * @brief Execute the special 'empty' builtin command executed when no command
@@ -0,0 +1,916 @@
+#include "cache.h"
+#include "io.h"        // For io_flush, io_printf
+#include "process.h"   // For launch_process_with_options, LAUNCH_SIGNAL_STATUS_BASE
+#include <dirent.h>    // For opendir, readdir
+#include <errno.h>     // For errno, EEXIST
+#include <fcntl.h>     // For open, O_CLOEXEC
+#include <stdbool.h>   // For bool
+#include <stdio.h>     // For snprintf, fopen, fprintf
+#include <stdlib.h>    // For getenv, malloc, realloc, qsort
+#include <string.h>    // For strlen, strcmp
+#include <sys/file.h>  // For flock
+#include <sys/stat.h>  // For stat, mkdir
+#include <sys/types.h> // For off_t
+#include <time.h>      // For time
+#include <unistd.h>    // For getcwd, read, write, unlink
+
+// Array sizes must be integer constant expressions in C, so an enum is used
+// here instead of `static const`.
+enum
+{
+    CACHE_HASH_LENGTH = 32,   // Hex digits of a 128 bit hash
+    CACHE_PATH_LENGTH = 4096, // Longest path of a file in the store
+    // Longest path of the store itself, leaving room for the names in it
+    CACHE_DIRECTORY_LENGTH = CACHE_PATH_LENGTH - 128,
+    CACHE_COPY_CHUNK = 65536, // Bytes copied at once when hashing/replaying
+};
+
+// Name of the environment variable that overrides the store directory
+static const char *CACHE_DIR_ENV = "JOSH_CACHE_DIR";
+
+// Name of the environment variable with the size cap of the store, in bytes.
+// The least recently used entries are evicted above it.
+static const char *CACHE_MAX_BYTES_ENV = "JOSH_CACHE_MAX_BYTES";
+
+// Size cap of the store when CACHE_MAX_BYTES_ENV is not set (64 MiB)
+static const long long CACHE_DEFAULT_MAX_BYTES = 64LL * 1024 * 1024;
+
+// Temporary files (captures in progress) start with this prefix, so they are
+// never mistaken for objects
+static const char *CACHE_TEMPORARY_PREFIX = ".tmp-";
+
+// Temporary files older than this are leftovers of a shell that died
+static const time_t CACHE_TEMPORARY_MAX_AGE = 3600;
+
+// Numbers the temporary files of this shell, see temporary_create
+static unsigned temporary_counter = 0;
+
+// Keys and objects are named after the 128 bit FNV-1a hash of their content.
+// It is not a cryptographic hash, but collisions are not a practical concern
+// for a per-user cache and it is tiny and fast.
+typedef unsigned __int128 CacheHash;
+
+static const CacheHash FNV128_OFFSET = ((CacheHash)0x6c62272e07bb0142ULL << 64) | 0x62b821756295c58dULL;
+static const CacheHash FNV128_PRIME = ((CacheHash)1 << 88) | 0x13b;
+
+// Everything known about an entry, as stored in its manifest
+typedef struct
+{
+    char key[CACHE_HASH_LENGTH + 1];
+    time_t last_used; // mtime of the manifest
+    long long created;
+    int status;
+    char stdout_object[CACHE_HASH_LENGTH + 1];
+    char stderr_object[CACHE_HASH_LENGTH + 1];
+} CacheEntry;
+
+// =================================================================
+// Private helpers: hashing
+// =================================================================
+
+static void hash_bytes(CacheHash *hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        *hash ^= bytes[i];
+        *hash *= FNV128_PRIME;
+    }
+}
+
+static void hash_string(CacheHash *hash, const char *string)
+{
+    // The terminating '\0' is hashed as well, so that ["ab", "c"] and
+    // ["a", "bc"] get different hashes
+    hash_bytes(hash, string, strlen(string) + 1);
+}
+
+static void hash_to_hex(CacheHash hash, char hex[CACHE_HASH_LENGTH + 1])
+{
+    snprintf(hex, CACHE_HASH_LENGTH + 1, "%016llx%016llx", (unsigned long long)(hash >> 64),
+             (unsigned long long)hash);
+}
+
+static bool hash_fd(int fd, char hex[CACHE_HASH_LENGTH + 1])
+{
+    CacheHash hash = FNV128_OFFSET;
+    char buffer[CACHE_COPY_CHUNK];
+    ssize_t bytes;
+
+    if (lseek(fd, 0, SEEK_SET) == -1)
+    {
+        return false;
+    }
+
+    while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        hash_bytes(&hash, buffer, bytes);
+    }
+
+    hash_to_hex(hash, hex);
+    return bytes == 0;
+}
+
+/**
+ * @brief Computes the key of a command: its arguments, the working directory,
+ *  PATH plus the requested environment variables and the metadata of the
+ *  declared dependencies.
+ */
+static void cache_compute_key(const ParsedInput *command, const CacheRequest *request,
+                              char key[CACHE_HASH_LENGTH + 1])
+{
+    CacheHash hash = FNV128_OFFSET;
+    hash_string(&hash, "josh-cache-v1");
+
+    hash_string(&hash, "argv");
+    for (uint i = 0; i < command->count; i++)
+    {
+        hash_string(&hash, command->arguments[i]);
+    }
+
+    char *cwd = getcwd(NULL, 0);
+    hash_string(&hash, "cwd");
+    hash_string(&hash, cwd != NULL ? cwd : "");
+    free(cwd);
+
+    // PATH decides which program actually runs, so it is always in the key
+    hash_string(&hash, "env");
+    for (int i = -1; i < request->environment_count; i++)
+    {
+        const char *name = i < 0 ? "PATH" : request->environment[i];
+        const char *value = getenv(name);
+        hash_string(&hash, name);
+        hash_bytes(&hash, value != NULL ? "=" : "!", 1); // Set vs unset
+        hash_string(&hash, value != NULL ? value : "");
+    }
+
+    hash_string(&hash, "deps");
+    for (int i = 0; i < request->dependency_count; i++)
+    {
+        struct stat file_stat;
+        hash_string(&hash, request->dependencies[i]);
+
+        if (stat(request->dependencies[i], &file_stat) == 0)
+        {
+            long long metadata[] = {file_stat.st_mtim.tv_sec, file_stat.st_mtim.tv_nsec, file_stat.st_size,
+                                    (long long)file_stat.st_ino, (long long)file_stat.st_dev};
+            hash_bytes(&hash, metadata, sizeof(metadata));
+        }
+        else
+        {
+            hash_string(&hash, "missing");
+        }
+    }
+
+    hash_to_hex(hash, key);
+}
+
+// =================================================================
+// Private helpers: the store on disk
+// =================================================================
+
+static bool make_directory(const char *path)
+{
+    return mkdir(path, 0700) == 0 || errno == EEXIST;
+}
+
+/**
+ * @brief Creates a temporary file in the objects directory of the store. Its
+ *  name has the pid of the shell and a counter, so that neither another shell
+ *  nor another stage of the same pipeline picks it too. Leftovers are removed
+ *  by cache_collect_garbage.
+ *
+ * @param path Where the path of the file is stored.
+ * @return A descriptor of the new file, or -1 on error.
+ */
+static int temporary_create(const char *directory, char path[CACHE_PATH_LENGTH])
+{
+    int fd;
+
+    do
+    {
+        // A leftover of a dead shell may have the same pid, hence the retries
+        unsigned counter = __atomic_fetch_add(&temporary_counter, 1, __ATOMIC_RELAXED);
+        snprintf(path, CACHE_PATH_LENGTH, "%s/objects/%s%d-%u", directory, CACHE_TEMPORARY_PREFIX, (int)getpid(),
+                 counter);
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    } while (fd == -1 && errno == EEXIST);
+
+    return fd;
+}
+
+/**
+ * @brief Takes the lock of the store (a flock on its `lock` file). Shells
+ *  storing an entry share it, so that the eviction, which takes it
+ *  exclusively, never removes an object between its rename into the store and
+ *  the write of the manifest referencing it. Updates of the statistics take it
+ *  exclusively as well.
+ *
+ * @param operation LOCK_SH or LOCK_EX.
+ * @return A descriptor holding the lock, for cache_unlock, or -1 if it could
+ *         not be taken (the store is then used without it).
+ */
+static int cache_lock(const char *directory, int operation)
+{
+    char path[CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/lock", directory);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    int locked;
+    while ((locked = flock(fd, operation)) == -1 && errno == EINTR)
+    {
+    }
+
+    if (locked == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void cache_unlock(int fd)
+{
+    if (fd != -1)
+    {
+        close(fd); // Releases the flock
+    }
+}
+
+/**
+ * @brief Finds (and creates if needed) the directory of the store.
+ */
+static bool cache_directory(char directory[CACHE_DIRECTORY_LENGTH])
+{
+    const char *override = getenv(CACHE_DIR_ENV);
+    const char *xdg_cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int length;
+
+    if (override != NULL && override[0] != '\0')
+    {
+        length = snprintf(directory, CACHE_DIRECTORY_LENGTH, "%s", override);
+    }
+    else if (xdg_cache != NULL && xdg_cache[0] != '\0')
+    {
+        make_directory(xdg_cache);
+        length = snprintf(directory, CACHE_DIRECTORY_LENGTH, "%s/josh", xdg_cache);
+    }
+    else if (home != NULL)
+    {
+        char parent[CACHE_DIRECTORY_LENGTH];
+        if (snprintf(parent, sizeof(parent), "%s/.cache", home) < (int)sizeof(parent))
+        {
+            make_directory(parent);
+        }
+        length = snprintf(directory, CACHE_DIRECTORY_LENGTH, "%s/.cache/josh", home);
+    }
+    else
+    {
+        fprintf(stderr, "myshell: cache: no cache directory, set %s\n", CACHE_DIR_ENV);
+        return false;
+    }
+
+    // Every path built from it then fits in CACHE_PATH_LENGTH
+    if (length >= CACHE_DIRECTORY_LENGTH)
+    {
+        fprintf(stderr, "myshell: cache: path of the cache directory too long\n");
+        return false;
+    }
+
+    char objects[CACHE_PATH_LENGTH];
+    char keys[CACHE_PATH_LENGTH];
+    snprintf(objects, sizeof(objects), "%s/objects", directory);
+    snprintf(keys, sizeof(keys), "%s/keys", directory);
+
+    if (!make_directory(directory) || !make_directory(objects) || !make_directory(keys))
+    {
+        perror("myshell: cache");
+        return false;
+    }
+
+    return true;
+}
+
+static bool copy_fd(int source_fd, int destination_fd)
+{
+    char buffer[CACHE_COPY_CHUNK];
+    ssize_t bytes;
+
+    while ((bytes = read(source_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t written = 0; written < bytes;)
+        {
+            ssize_t result = write(destination_fd, buffer + written, bytes - written);
+            if (result == -1)
+            {
+                return false;
+            }
+            written += result;
+        }
+    }
+
+    return bytes == 0;
+}
+
+static int open_object(const char *directory, const char *object)
+{
+    char path[CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/objects/%s", directory, object);
+
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/**
+ * @brief Whether the input is a terminal or /dev/null (character devices),
+ *  which no deterministic command reads its data from.
+ */
+static bool input_is_device(int fd)
+{
+    struct stat input_stat;
+    return fstat(fd, &input_stat) == -1 || S_ISCHR(input_stat.st_mode);
+}
+
+/**
+ * @brief Moves a captured output into the store under the hash of its content,
+ *  or discards it if an identical object is already there.
+ */
+static bool store_object(const char *directory, int fd, const char *temporary_path,
+                         char object[CACHE_HASH_LENGTH + 1])
+{
+    if (!hash_fd(fd, object))
+    {
+        return false;
+    }
+
+    char path[CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/objects/%s", directory, object);
+
+    if (access(path, F_OK) == 0)
+    {
+        unlink(temporary_path);
+        return true;
+    }
+
+    return rename(temporary_path, path) == 0;
+}
+
+static bool manifest_read(const char *directory, const char *key, CacheEntry *entry)
+{
+    char path[CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/keys/%s", directory, key);
+
+    FILE *manifest = fopen(path, "r");
+    if (manifest == NULL)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    fstat(fileno(manifest), &file_stat);
+
+    snprintf(entry->key, sizeof(entry->key), "%s", key);
+    entry->last_used = file_stat.st_mtime;
+
+    int fields = fscanf(manifest, "josh-cache 1\ncreated %lld\nstatus %d\nstdout %32s\nstderr %32s\n",
+                        &entry->created, &entry->status, entry->stdout_object, entry->stderr_object);
+    fclose(manifest);
+
+    return fields == 4;
+}
+
+static bool manifest_write(const char *directory, const CacheEntry *entry)
+{
+    char path[CACHE_PATH_LENGTH];
+    char temporary_path[CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/keys/%s", directory, entry->key);
+
+    int temporary_fd = temporary_create(directory, temporary_path);
+    if (temporary_fd == -1)
+    {
+        return false;
+    }
+    FILE *manifest = fdopen(temporary_fd, "w");
+    if (manifest == NULL)
+    {
+        close(temporary_fd);
+        unlink(temporary_path);
+        return false;
+    }
+
+    fprintf(manifest, "josh-cache 1\ncreated %lld\nstatus %d\nstdout %s\nstderr %s\n", entry->created, entry->status,
+            entry->stdout_object, entry->stderr_object);
+
+    // Written to a temporary file and renamed, so that other shells never
+    // read a half written manifest
+    bool written = fclose(manifest) == 0 && rename(temporary_path, path) == 0;
+    if (!written)
+    {
+        unlink(temporary_path);
+    }
+
+    return written;
+}
+
+/**
+ * @brief Adds the given amounts to the statistics file of the store.
+ */
+static void stats_update(const char *directory, long long hits, long long misses, long long evictions)
+{
+    char path[CACHE_PATH_LENGTH];
+    char temporary_path[CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/stats", directory);
+
+    // Read, add and write back under the lock, or the updates of other shells
+    // and stages could be lost
+    int lock_fd = cache_lock(directory, LOCK_EX);
+
+    long long total_hits = 0;
+    long long total_misses = 0;
+    long long total_evictions = 0;
+
+    FILE *stats = fopen(path, "r");
+    if (stats != NULL)
+    {
+        if (fscanf(stats, "hits %lld\nmisses %lld\nevictions %lld\n", &total_hits, &total_misses,
+                   &total_evictions) != 3)
+        {
+            total_hits = total_misses = total_evictions = 0;
+        }
+        fclose(stats);
+    }
+
+    int temporary_fd = temporary_create(directory, temporary_path);
+    stats = temporary_fd != -1 ? fdopen(temporary_fd, "w") : NULL;
+    if (stats == NULL)
+    {
+        if (temporary_fd != -1)
+        {
+            close(temporary_fd);
+            unlink(temporary_path);
+        }
+        cache_unlock(lock_fd);
+        return;
+    }
+
+    fprintf(stats, "hits %lld\nmisses %lld\nevictions %lld\n", total_hits + hits, total_misses + misses,
+            total_evictions + evictions);
+
+    if (fclose(stats) != 0 || rename(temporary_path, path) != 0)
+    {
+        unlink(temporary_path);
+    }
+
+    cache_unlock(lock_fd);
+}
+
+/**
+ * @brief Loads the manifests of every entry of the store.
+ *
+ * @param count Where the number of entries loaded is stored.
+ * @return A heap allocated array of entries (to be freed by the caller), or
+ *         NULL if there are none.
+ */
+static CacheEntry *cache_load_entries(const char *directory, int *count)
+{
+    char keys_path[CACHE_PATH_LENGTH];
+    snprintf(keys_path, sizeof(keys_path), "%s/keys", directory);
+
+    *count = 0;
+    DIR *keys = opendir(keys_path);
+    if (keys == NULL)
+    {
+        return NULL;
+    }
+
+    int capacity = 0;
+    CacheEntry *entries = NULL;
+    struct dirent *file;
+
+    while ((file = readdir(keys)) != NULL)
+    {
+        if (strlen(file->d_name) != CACHE_HASH_LENGTH)
+        {
+            continue; // ".", "..", and temporary files
+        }
+
+        if (*count >= capacity)
+        {
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            entries = realloc(entries, sizeof(CacheEntry) * capacity);
+        }
+
+        if (manifest_read(directory, file->d_name, &entries[*count]))
+        {
+            (*count)++;
+        }
+    }
+
+    closedir(keys);
+    return entries;
+}
+
+static off_t object_size(const char *directory, const char *object)
+{
+    char path[CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/objects/%s", directory, object);
+
+    struct stat file_stat;
+    return stat(path, &file_stat) == 0 ? file_stat.st_size : 0;
+}
+
+/**
+ * @brief Adds up the size of every object in the store.
+ */
+static long long cache_objects_size(const char *directory)
+{
+    char objects_path[CACHE_PATH_LENGTH];
+    snprintf(objects_path, sizeof(objects_path), "%s/objects", directory);
+
+    DIR *objects = opendir(objects_path);
+    if (objects == NULL)
+    {
+        return 0;
+    }
+
+    long long total = 0;
+    struct dirent *file;
+    while ((file = readdir(objects)) != NULL)
+    {
+        if (strlen(file->d_name) == CACHE_HASH_LENGTH)
+        {
+            total += object_size(directory, file->d_name);
+        }
+    }
+
+    closedir(objects);
+    return total;
+}
+
+static long long cache_max_bytes(void)
+{
+    const char *max_bytes = getenv(CACHE_MAX_BYTES_ENV);
+
+    if (max_bytes != NULL && max_bytes[0] != '\0')
+    {
+        return atoll(max_bytes);
+    }
+
+    return CACHE_DEFAULT_MAX_BYTES;
+}
+
+static int compare_entries_newest_first(const void *a, const void *b)
+{
+    const CacheEntry *first = a;
+    const CacheEntry *second = b;
+
+    return (first->last_used < second->last_used) - (first->last_used > second->last_used);
+}
+
+static bool entry_references(const CacheEntry *entry, const char *object)
+{
+    return !strcmp(entry->stdout_object, object) || !strcmp(entry->stderr_object, object);
+}
+
+/**
+ * @brief Removes objects no longer referenced by any entry, and temporary
+ *  files left behind by shells that died while capturing.
+ */
+static void cache_collect_garbage(const char *directory, const CacheEntry *entries, int count)
+{
+    char objects_path[CACHE_PATH_LENGTH];
+    snprintf(objects_path, sizeof(objects_path), "%s/objects", directory);
+
+    DIR *objects = opendir(objects_path);
+    if (objects == NULL)
+    {
+        return;
+    }
+
+    time_t now = time(NULL);
+    struct dirent *file;
+    while ((file = readdir(objects)) != NULL)
+    {
+        char path[CACHE_PATH_LENGTH];
+        if (snprintf(path, sizeof(path), "%s/%s", objects_path, file->d_name) >= (int)sizeof(path))
+        {
+            continue; // Not a name of the store
+        }
+
+        if (!strncmp(file->d_name, CACHE_TEMPORARY_PREFIX, strlen(CACHE_TEMPORARY_PREFIX)))
+        {
+            struct stat file_stat;
+            if (stat(path, &file_stat) == 0 && now - file_stat.st_mtime > CACHE_TEMPORARY_MAX_AGE)
+            {
+                unlink(path);
+            }
+            continue;
+        }
+
+        if (strlen(file->d_name) != CACHE_HASH_LENGTH)
+        {
+            continue;
+        }
+
+        bool referenced = false;
+        for (int i = 0; i < count && !referenced; i++)
+        {
+            referenced = entry_references(&entries[i], file->d_name);
+        }
+
+        if (!referenced)
+        {
+            unlink(path);
+        }
+    }
+
+    closedir(objects);
+}
+
+/**
+ * @brief Evicts the least recently used entries until the objects they keep
+ *  alive fit in the size cap of the store.
+ */
+static void cache_evict(const char *directory)
+{
+    long long max_bytes = cache_max_bytes();
+
+    if (cache_objects_size(directory) <= max_bytes)
+    {
+        return;
+    }
+
+    int lock_fd = cache_lock(directory, LOCK_EX);
+
+    int count = 0;
+    CacheEntry *entries = cache_load_entries(directory, &count);
+    qsort(entries, count, sizeof(CacheEntry), compare_entries_newest_first);
+
+    // Walk from the most to the least recently used entry, keeping entries
+    // while they fit. Objects shared by several entries are counted once per
+    // entry, which only makes the eviction slightly more eager.
+    long long kept_bytes = 0;
+    int kept = 0;
+    long long evictions = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        long long size = object_size(directory, entries[i].stdout_object);
+        if (strcmp(entries[i].stdout_object, entries[i].stderr_object) != 0)
+        {
+            size += object_size(directory, entries[i].stderr_object);
+        }
+
+        if (kept_bytes + size <= max_bytes)
+        {
+            kept_bytes += size;
+            entries[kept++] = entries[i];
+            continue;
+        }
+
+        char path[CACHE_PATH_LENGTH];
+        snprintf(path, sizeof(path), "%s/keys/%s", directory, entries[i].key);
+        unlink(path);
+        evictions++;
+    }
+
+    cache_collect_garbage(directory, entries, kept);
+    cache_unlock(lock_fd);
+
+    stats_update(directory, 0, 0, evictions);
+    free(entries);
+}
+
+/**
+ * @brief Runs the command straight to the streams of the builtin, when the
+ *  store can't be used.
+ */
+static CommandResult cache_run_uncached(const ParsedInput *command, CommandIO *io)
+{
+    LaunchOptions options = launch_options_default();
+    options.stdin_fd = io->input_fd;
+    options.stdout_fd = io->output_fd;
+
+    io_flush(io);
+    return launch_process_with_options(command, &options, NULL);
+}
+
+/**
+ * @brief Replays a stored entry. Fails (so the caller falls back to running
+ *  the command) if any of its objects is gone.
+ */
+static bool cache_replay(const char *directory, const CacheEntry *entry, CommandIO *io)
+{
+    // Both objects are opened before writing anything: once open, an eviction
+    // by another shell can't take them away anymore
+    int stdout_fd = open_object(directory, entry->stdout_object);
+    int stderr_fd = stdout_fd == -1 ? -1 : open_object(directory, entry->stderr_object);
+    if (stdout_fd == -1 || stderr_fd == -1)
+    {
+        if (stdout_fd != -1)
+        {
+            close(stdout_fd);
+        }
+        return false;
+    }
+
+    fflush(stderr);
+    io_flush(io);
+
+    bool replayed = copy_fd(stdout_fd, io->output_fd) && copy_fd(stderr_fd, STDERR_FILENO);
+
+    close(stdout_fd);
+    close(stderr_fd);
+
+    return replayed;
+}
+
+/**
+ * @brief Runs the command capturing its outputs, replays them and stores them
+ *  as the entry for `key`.
+ */
+static CommandResult cache_capture(const char *directory, const ParsedInput *command, const char *key,
+                                   CommandIO *io)
+{
+    char stdout_path[CACHE_PATH_LENGTH];
+    char stderr_path[CACHE_PATH_LENGTH];
+    int stdout_fd = temporary_create(directory, stdout_path);
+    int stderr_fd = stdout_fd == -1 ? -1 : temporary_create(directory, stderr_path);
+    if (stdout_fd == -1 || stderr_fd == -1)
+    {
+        perror("myshell: cache");
+        if (stdout_fd != -1)
+        {
+            close(stdout_fd);
+            unlink(stdout_path);
+        }
+
+        // The store is unusable, but the command can still be run
+        return cache_run_uncached(command, io);
+    }
+
+    LaunchOptions options = launch_options_default();
+    options.stdin_fd = io->input_fd;
+    options.stdout_fd = stdout_fd;
+    options.stderr_fd = stderr_fd;
+    // A command that can't be executed fails (with its error in the captured
+    // stderr) instead of looking like one that exited with 1
+    options.wait_for_exec = true;
+
+    CacheEntry entry;
+    snprintf(entry.key, sizeof(entry.key), "%s", key);
+    entry.created = time(NULL);
+    entry.status = launch_process_with_options(command, &options, NULL);
+
+    // The outputs go to the user first, the store is only an optimization
+    fflush(stderr);
+    io_flush(io);
+    lseek(stdout_fd, 0, SEEK_SET);
+    lseek(stderr_fd, 0, SEEK_SET);
+    copy_fd(stdout_fd, io->output_fd);
+    copy_fd(stderr_fd, STDERR_FILENO);
+
+    // A command that could not be run (missing, not executable) may be
+    // installed before the next run, it is never stored. A command killed by
+    // a signal (Ctrl+C, OOM killer...) may have been cut short, its outputs
+    // are not worth keeping. Its status can't be told apart from an exit
+    // status above 128, which is not stored either.
+    bool completed = entry.status >= 0 && entry.status <= LAUNCH_SIGNAL_STATUS_BASE;
+    int lock_fd = completed ? cache_lock(directory, LOCK_SH) : -1;
+    bool stored = completed && store_object(directory, stdout_fd, stdout_path, entry.stdout_object) &&
+                  store_object(directory, stderr_fd, stderr_path, entry.stderr_object) &&
+                  manifest_write(directory, &entry);
+    cache_unlock(lock_fd);
+
+    close(stdout_fd);
+    close(stderr_fd);
+
+    if (!stored)
+    {
+        // Whatever was not renamed into the store is still a temporary file
+        unlink(stdout_path);
+        unlink(stderr_path);
+    }
+
+    // Same status as when the failed exec is reported by the child
+    return entry.status < 0 ? EXIT_FAILURE : entry.status;
+}
+
+// =================================================================
+// Public functions
+// =================================================================
+
+CommandResult cache_run(const ParsedInput *command, const CacheRequest *request, CommandIO *io)
+{
+    // The input is not part of the key, so a command that may read data from
+    // it (a pipe, a file) runs without the cache. Reading the input ahead to
+    // hash it would never end with `yes | cache head -1`, and could swallow
+    // the rest of the script when it is the shell's own stdin.
+    char directory[CACHE_DIRECTORY_LENGTH];
+    if (!input_is_device(io->input_fd) || !cache_directory(directory))
+    {
+        return cache_run_uncached(command, io);
+    }
+
+    char key[CACHE_HASH_LENGTH + 1];
+    cache_compute_key(command, request, key);
+
+    CacheEntry entry;
+    if (manifest_read(directory, key, &entry))
+    {
+        bool fresh = request->ttl_seconds <= 0 || difftime(time(NULL), entry.created) <= request->ttl_seconds;
+
+        if (fresh && cache_replay(directory, &entry, io))
+        {
+            // Refresh the mtime of the manifest, the eviction is LRU
+            char path[CACHE_PATH_LENGTH];
+            snprintf(path, sizeof(path), "%s/keys/%s", directory, key);
+            utimensat(AT_FDCWD, path, NULL, 0);
+
+            stats_update(directory, 1, 0, 0);
+            return entry.status;
+        }
+    }
+
+    CommandResult status = cache_capture(directory, command, key, io);
+
+    stats_update(directory, 0, 1, 0);
+    cache_evict(directory);
+
+    return status;
+}
+
+CommandResult cache_print_stats(CommandIO *io)
+{
+    char directory[CACHE_DIRECTORY_LENGTH];
+    if (!cache_directory(directory))
+    {
+        return 1;
+    }
+
+    long long hits = 0;
+    long long misses = 0;
+    long long evictions = 0;
+
+    char path[CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/stats", directory);
+
+    FILE *stats = fopen(path, "r");
+    if (stats != NULL)
+    {
+        if (fscanf(stats, "hits %lld\nmisses %lld\nevictions %lld\n", &hits, &misses, &evictions) != 3)
+        {
+            hits = misses = evictions = 0;
+        }
+        fclose(stats);
+    }
+
+    int count = 0;
+    free(cache_load_entries(directory, &count));
+
+    long long lookups = hits + misses;
+    io_printf(io, "directory  %s\n", directory);
+    io_printf(io, "hits       %lld\n", hits);
+    io_printf(io, "misses     %lld\n", misses);
+    io_printf(io, "hit ratio  %.1f%%\n", lookups > 0 ? 100.0 * hits / lookups : 0.0);
+    io_printf(io, "evictions  %lld\n", evictions);
+    io_printf(io, "entries    %d\n", count);
+    io_printf(io, "size       %lld bytes (max %lld)\n", cache_objects_size(directory),
+              cache_max_bytes());
+
+    return 0;
+}
+
+CommandResult cache_clear(void)
+{
+    char directory[CACHE_DIRECTORY_LENGTH];
+    if (!cache_directory(directory))
+    {
+        return 1;
+    }
+
+    int lock_fd = cache_lock(directory, LOCK_EX);
+
+    // Removing every manifest makes every object unreferenced
+    int count = 0;
+    CacheEntry *entries = cache_load_entries(directory, &count);
+    for (int i = 0; i < count; i++)
+    {
+        char path[CACHE_PATH_LENGTH];
+        snprintf(path, sizeof(path), "%s/keys/%s", directory, entries[i].key);
+        unlink(path);
+    }
+    free(entries);
+
+    cache_collect_garbage(directory, NULL, 0);
+    cache_unlock(lock_fd);
+
+    return 0;
+}
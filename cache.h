@@ -0,0 +1,67 @@
+#ifndef MYSHELL_CACHE_H
+#define MYSHELL_CACHE_H
+
+#include "command.h" // For ParsedInput, CommandResult, CommandIO
+
+// Memoization of the output of deterministic external commands. An entry is
+// keyed by the arguments of the command, the working directory, a selection of
+// environment variables and the metadata (mtime, size, inode) of the files the
+// command declares to depend on. The captured stdout, stderr and exit status
+// are kept in an on-disk store and replayed when the same key is seen again.
+// The input is not part of the key: a command whose stdin is not a terminal or
+// /dev/null (e.g. the second stage of a pipeline) is run without the cache.
+//
+// The store lives in $JOSH_CACHE_DIR, $XDG_CACHE_HOME/josh or ~/.cache/josh,
+// and is capped to $JOSH_CACHE_MAX_BYTES (64 MiB by default):
+//
+//     objects/<hash>  Captured outputs, named after the hash of their content,
+//                     so identical outputs are stored once
+//     keys/<hash>     One small manifest per key, pointing to its objects. Its
+//                     mtime is refreshed on every hit (for the LRU eviction)
+//     stats           Hits, misses and evictions of all the shells so far
+//     lock            flock'ed by the shells storing entries (shared) and by
+//                     the eviction and the statistics updates (exclusive)
+
+/**
+ * @brief What, besides the command itself, makes up the key of an entry.
+ */
+typedef struct
+{
+    double ttl_seconds;    // Age after which an entry is stale, 0 for never
+    char **dependencies;   // Files whose metadata is part of the key
+    int dependency_count;  // Number of elements in dependencies
+    char **environment;    // Environment variables part of the key
+    int environment_count; // Number of elements in environment
+} CacheRequest;
+
+/**
+ * @brief Runs an external command through the cache: the stored outputs are
+ *  replayed on a hit, otherwise the command is launched, its outputs captured
+ *  and stored, then replayed. A command that can't be executed or is killed
+ *  by a signal is not stored.
+ *
+ * @param command The external command to run, with its arguments.
+ * @param request The rest of the key and the expiration of the entry.
+ * @param io      Streams of the command: it reads from the input, and its
+ *                standard output (captured or replayed) goes to the output.
+ * @return The (possibly replayed) exit status of the command, or a failure
+ *         code if it could not be run.
+ */
+CommandResult cache_run(const ParsedInput *command, const CacheRequest *request, CommandIO *io);
+
+/**
+ * @brief Prints the hit/miss statistics and the usage of the store.
+ *
+ * @param io Where the statistics are written.
+ * @return 0 on success, 1 if the store can't be read.
+ */
+CommandResult cache_print_stats(CommandIO *io);
+
+/**
+ * @brief Removes every entry of the store (the statistics are kept).
+ *
+ * @return 0 on success, 1 on failure.
+ */
+CommandResult cache_clear(void);
+
+#endif // !MYSHELL_CACHE_H
@@ -1,6 +1,8 @@
 #ifndef MYSHELL_COMMAND_H
 #define MYSHELL_COMMAND_H
 
+#include <stdbool.h>   // For bool
+#include <stddef.h>    // For size_t
 #include <sys/types.h> // For uint
 
 // --- Foundational Type Definitions ---
@@ -8,19 +10,37 @@
 // The result code for any command, built-in or external
 typedef int CommandResult;
 
+// Array sizes must be integer constant expressions in C, so an enum is used
+// here instead of `static const`.
+enum
+{
+    COMMAND_IO_BUFFER_SIZE = 4096, // Output buffered by a command before a write
+};
+
+// The streams of a running command. Builtins read their input from input_fd and
+// write their output through io_write/io_printf (see io.h), which buffer it and
+// send it to output_fd. Each command gets its own CommandIO, so builtins can
+// run concurrently (e.g. as stages of a pipeline) without sharing any state.
+typedef struct
+{
+    int input_fd;  // Where the command reads its input from
+    int output_fd; // Where the command writes its output to
+    size_t used;   // Bytes of buffer waiting to be written
+    bool failed;   // A write failed (e.g. the reader of a pipe went away)
+    char buffer[COMMAND_IO_BUFFER_SIZE];
+} CommandIO;
+
 /**
  * @brief Format for the functions that implement commands
  * 
- * @param argc          The number of arguments in the argv array.
- * @param argv          An array of string arguments for the command.
- * @param output_buffer A buffer provided by the caller where this function can
- *                      write its text output.
- * @param buffer_size   The total size in bytes of the output_buffer. Used to
- *                      prevent buffer overflows.
+ * @param argc The number of arguments in the argv array.
+ * @param argv An array of string arguments for the command.
+ * @param io   The streams of the command. Its text output must be written
+ *             through io_write/io_printf, never directly to stdout.
  * 
- * @return              Returns 0 on success, or a non-zero value on failure.
+ * @return     Returns 0 on success, or a non-zero value on failure.
  */
-typedef CommandResult CommandFunction(int argc, char *argv[], char *output_buffer, size_t buffer_size);
+typedef CommandResult CommandFunction(int argc, char *argv[], CommandIO *io);
 
 // The data structure returned by the parser and used to launch commands.
 // Needed by main.c (to create it) and builtins.c (to use it).
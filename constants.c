@@ -0,0 +1,6 @@
+#include "constants.h"
+
+const char *const DEFAULT_PATH_RAW = "/";
+
+const char *const DEFAULT_PROMPT_OPENING = "myshell";
+const char *const DEFAULT_PROMPT_CLOSING = " -> ";
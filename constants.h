@@ -2,10 +2,10 @@
 #define MYSHELL_CONSTANTS_H
 
 // --- Compile-Time Constants (Self-Contained Values) ---
-// Use `static const` for simple, literal-like values.
-// This is type-safe, modular, and optimized away by the compiler.
-// It avoids creating unnecessary dependencies.
-static const char *DEFAULT_PATH_RAW = "/";
+// Declared here and defined once in constants.c: as `static const` every file
+// including this header would get its own copy, and a warning for each one it
+// does not use.
+extern const char *const DEFAULT_PATH_RAW;
 
 // --- Internal Architectural Limits ---
 // These are safety nets and design decisions, not user preferences.
@@ -13,8 +13,8 @@ static const char *DEFAULT_PATH_RAW = "/";
 // static const int MAX_INPUT_BUFFER_SIZE = 4096;
 
 // --- Default Identifiers ---
-static const char *DEFAULT_PROMPT_OPENING = "myshell";
-static const char *DEFAULT_PROMPT_CLOSING = " -> ";
+extern const char *const DEFAULT_PROMPT_OPENING;
+extern const char *const DEFAULT_PROMPT_CLOSING;
 // static const char* CONFIG_FILENAME = ".myshellrc";
 
 #endif // !MYSHELL_CONSTANTS_H
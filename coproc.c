@@ -0,0 +1,400 @@
+#define _GNU_SOURCE // For pipe2, must come before any #include
+
+#include "coproc.h"
+#include "io.h"      // For io_init, io_write, io_printf, io_flush
+#include "parser.h"  // For parsed_input_destroy
+#include "process.h" // For spawn_process, wait_process
+#include <errno.h>   // For errno, EINTR
+#include <fcntl.h>   // For O_CLOEXEC, fcntl
+#include <pthread.h> // For pthread_mutex_t
+#include <signal.h>  // For SIGTERM
+#include <stdio.h>   // For fdopen, getline, fprintf
+#include <stdlib.h>  // For malloc, free, atexit
+#include <string.h>  // For strcmp, strdup, strlen
+#include <unistd.h>  // For pipe2, close, getpid, read
+
+// Array sizes must be integer constant expressions in C, so an enum is used
+// here instead of `static const`.
+enum
+{
+    COPROC_MAX = 16,         // Coprocesses running at once
+    COPROC_NAME_LENGTH = 32, // Longest name, '\0' included
+    COPROC_COPY_CHUNK = 16384, // Bytes of input forwarded at once, see coproc_write_input
+};
+
+// Time a coprocess has to exit once its stdin is closed, then to handle the
+// SIGTERM, before it is killed
+static const double COPROC_EXIT_GRACE_SECONDS = 1;
+
+typedef struct
+{
+    bool used;
+    char name[COPROC_NAME_LENGTH];
+    ParsedInput command; // Own copy, for the trace when it is reaped
+    pid_t pid;
+    // Requests: output_fd is the pipe to its stdin. Builtin stages of a
+    // pipeline run on threads, hence the locks.
+    CommandIO requests;
+    pthread_mutex_t requests_lock;
+    // Answers: buffered stream over the pipe from its stdout
+    FILE *answers;
+    char *line; // Last line read, reused from one read to the next
+    size_t line_capacity;
+    pthread_mutex_t answers_lock;
+} Coprocess;
+
+// Only changed by coproc_start/coproc_close, which run on the main thread of
+// the shell (they are builtins that mutate its state), never while a pipeline
+// is running.
+static Coprocess coprocesses[COPROC_MAX];
+static pid_t owner_pid = 0; // Only this process may reap them
+static bool exit_handler_set = false;
+
+// =================================================================
+// Private helpers
+// =================================================================
+
+static Coprocess *coproc_find(const char *name)
+{
+    for (int i = 0; i < COPROC_MAX; i++)
+    {
+        if (coprocesses[i].used && !strcmp(coprocesses[i].name, name))
+        {
+            return &coprocesses[i];
+        }
+    }
+
+    fprintf(stderr, "myshell: coproc: %s: no such coprocess\n", name);
+    return NULL;
+}
+
+/**
+ * @brief Copies the arguments of a command, presized to fit them exactly.
+ */
+static bool copy_command(const ParsedInput *command, ParsedInput *copy)
+{
+    copy->count = 0;
+    copy->arguments = malloc(sizeof(char *) * (command->count + 1));
+    if (copy->arguments == NULL)
+    {
+        return false;
+    }
+
+    for (uint i = 0; i < command->count; i++)
+    {
+        copy->arguments[i] = strdup(command->arguments[i]);
+        if (copy->arguments[i] == NULL)
+        {
+            parsed_input_destroy(copy);
+            return false;
+        }
+        copy->count++;
+    }
+    copy->arguments[copy->count] = NULL;
+
+    return true;
+}
+
+/**
+ * @brief Closes the pipes of a coprocess, reaps it and frees its slot.
+ *
+ * @return Exit status of the coprocess.
+ */
+static CommandResult coproc_stop(Coprocess *coprocess)
+{
+    // The end of its input is the signal to exit for most helpers
+    io_flush(&coprocess->requests);
+    close(coprocess->requests.output_fd);
+    fclose(coprocess->answers);
+
+    // Those that don't get a grace period, then SIGTERM, then SIGKILL
+    LaunchOptions options = launch_options_default();
+    options.timeout_seconds = COPROC_EXIT_GRACE_SECONDS;
+    options.timeout_signal = SIGTERM;
+    options.kill_after_seconds = COPROC_EXIT_GRACE_SECONDS;
+
+    CommandResult status = wait_process(&coprocess->command, coprocess->pid, &options, NULL);
+
+    parsed_input_destroy(&coprocess->command);
+    free(coprocess->line);
+    pthread_mutex_destroy(&coprocess->requests_lock);
+    pthread_mutex_destroy(&coprocess->answers_lock);
+    coprocess->used = false;
+
+    return status;
+}
+
+/**
+ * @brief Sets or clears the close-on-exec flag of the shell's ends of the
+ *  pipes of every coprocess.
+ */
+static void coproc_set_close_on_exec(bool close_on_exec)
+{
+    for (int i = 0; i < COPROC_MAX; i++)
+    {
+        if (coprocesses[i].used)
+        {
+            int fds[] = {coprocesses[i].requests.output_fd, fileno(coprocesses[i].answers)};
+            for (int j = 0; j < 2; j++)
+            {
+                int flags = fcntl(fds[j], F_GETFD);
+                fcntl(fds[j], F_SETFD, close_on_exec ? flags | FD_CLOEXEC : flags & ~FD_CLOEXEC);
+            }
+        }
+    }
+}
+
+static void coproc_exit_handler(void)
+{
+    // A forked copy of the shell also runs the atexit handlers, the
+    // coprocesses are not its children.
+    if (getpid() != owner_pid)
+    {
+        return;
+    }
+
+    for (int i = 0; i < COPROC_MAX; i++)
+    {
+        if (coprocesses[i].used)
+        {
+            coproc_stop(&coprocesses[i]);
+        }
+    }
+}
+
+// =================================================================
+// Public functions
+// =================================================================
+
+CommandResult coproc_start(const char *name, const ParsedInput *command)
+{
+    if (name[0] == '\0' || strlen(name) >= COPROC_NAME_LENGTH)
+    {
+        fprintf(stderr, "myshell: coproc: %s: invalid name\n", name);
+        return 1;
+    }
+
+    Coprocess *coprocess = NULL;
+    for (int i = 0; i < COPROC_MAX; i++)
+    {
+        if (coprocesses[i].used && !strcmp(coprocesses[i].name, name))
+        {
+            fprintf(stderr, "myshell: coproc: %s: already running\n", name);
+            return 1;
+        }
+        if (!coprocesses[i].used && coprocess == NULL)
+        {
+            coprocess = &coprocesses[i];
+        }
+    }
+
+    if (coprocess == NULL)
+    {
+        fprintf(stderr, "myshell: coproc: too many coprocesses (max %d)\n", COPROC_MAX);
+        return 1;
+    }
+
+    int to_coprocess[2];
+    int from_coprocess[2];
+    if (pipe2(to_coprocess, O_CLOEXEC) == -1)
+    {
+        perror("myshell: coproc");
+        return 1;
+    }
+    if (pipe2(from_coprocess, O_CLOEXEC) == -1)
+    {
+        perror("myshell: coproc");
+        close(to_coprocess[0]);
+        close(to_coprocess[1]);
+        return 1;
+    }
+
+    LaunchOptions options = launch_options_default();
+    options.stdin_fd = to_coprocess[0];
+    options.stdout_fd = from_coprocess[1];
+    // A helper that does not exist must not take a slot
+    options.wait_for_exec = true;
+
+    // A coprocess holding the stdin of another one open would keep it from
+    // ever seeing its end
+    coproc_set_close_on_exec(true);
+    bool started = copy_command(command, &coprocess->command);
+    if (started)
+    {
+        coprocess->pid = spawn_process(&coprocess->command, &options);
+        started = coprocess->pid > 0;
+    }
+    coproc_set_close_on_exec(false);
+
+    // The coprocess has its own copy of its ends
+    close(to_coprocess[0]);
+    close(from_coprocess[1]);
+
+    coprocess->answers = started ? fdopen(from_coprocess[0], "r") : NULL;
+    if (coprocess->answers == NULL)
+    {
+        if (started)
+        {
+            perror("myshell: coproc");
+        }
+        close(to_coprocess[1]);
+        close(from_coprocess[0]);
+        if (started)
+        {
+            wait_process(&coprocess->command, coprocess->pid, NULL, NULL);
+        }
+        parsed_input_destroy(&coprocess->command);
+        return 1;
+    }
+
+    snprintf(coprocess->name, sizeof(coprocess->name), "%s", name);
+    io_init(&coprocess->requests, from_coprocess[0], to_coprocess[1]);
+    pthread_mutex_init(&coprocess->requests_lock, NULL);
+    coprocess->line = NULL;
+    coprocess->line_capacity = 0;
+    pthread_mutex_init(&coprocess->answers_lock, NULL);
+    coprocess->used = true;
+
+    // Its ends are exposed to the commands of the script (see coproc_print)
+    coproc_set_close_on_exec(false);
+
+    owner_pid = getpid();
+    if (!exit_handler_set)
+    {
+        atexit(coproc_exit_handler);
+        exit_handler_set = true;
+    }
+
+    return 0;
+}
+
+CommandResult coproc_write_line(const char *name, int word_count, char *words[])
+{
+    Coprocess *coprocess = coproc_find(name);
+    if (coprocess == NULL)
+    {
+        return 1;
+    }
+
+    pthread_mutex_lock(&coprocess->requests_lock);
+    for (int i = 0; i < word_count; i++)
+    {
+        if (i > 0)
+        {
+            io_write(&coprocess->requests, " ", 1);
+        }
+        io_write(&coprocess->requests, words[i], strlen(words[i]));
+    }
+    bool written = io_write(&coprocess->requests, "\n", 1);
+    pthread_mutex_unlock(&coprocess->requests_lock);
+
+    if (!written)
+    {
+        fprintf(stderr, "myshell: coproc: %s: not reading anymore\n", name);
+        return 1;
+    }
+
+    return 0;
+}
+
+CommandResult coproc_write_input(const char *name, int input_fd)
+{
+    Coprocess *coprocess = coproc_find(name);
+    if (coprocess == NULL)
+    {
+        return 1;
+    }
+
+    char chunk[COPROC_COPY_CHUNK];
+    ssize_t bytes = 0;
+    bool written = true;
+
+    // Held for the whole input, so that no line of another cowrite ends up in
+    // the middle of it
+    pthread_mutex_lock(&coprocess->requests_lock);
+    while (written && ((bytes = read(input_fd, chunk, sizeof(chunk))) > 0 || (bytes == -1 && errno == EINTR)))
+    {
+        if (bytes > 0)
+        {
+            written = io_write(&coprocess->requests, chunk, bytes);
+        }
+    }
+    pthread_mutex_unlock(&coprocess->requests_lock);
+
+    if (bytes == -1)
+    {
+        perror("myshell: cowrite");
+        return 1;
+    }
+    if (!written)
+    {
+        fprintf(stderr, "myshell: coproc: %s: not reading anymore\n", name);
+        return 1;
+    }
+
+    return 0;
+}
+
+CommandResult coproc_read_line(const char *name, CommandIO *io)
+{
+    Coprocess *coprocess = coproc_find(name);
+    if (coprocess == NULL)
+    {
+        return 1;
+    }
+
+    // Send the pending requests, or it may wait for them forever
+    pthread_mutex_lock(&coprocess->requests_lock);
+    io_flush(&coprocess->requests);
+    pthread_mutex_unlock(&coprocess->requests_lock);
+
+    pthread_mutex_lock(&coprocess->answers_lock);
+    ssize_t length = getline(&coprocess->line, &coprocess->line_capacity, coprocess->answers);
+    bool written = length > 0 && io_write(io, coprocess->line, length);
+
+    // The last line may lack its newline
+    if (written && coprocess->line[length - 1] != '\n')
+    {
+        written = io_write(io, "\n", 1);
+    }
+    pthread_mutex_unlock(&coprocess->answers_lock);
+
+    return written ? 0 : 1;
+}
+
+CommandResult coproc_close(const char *name)
+{
+    Coprocess *coprocess = coproc_find(name);
+    if (coprocess == NULL)
+    {
+        return 1;
+    }
+
+    return coproc_stop(coprocess);
+}
+
+void coproc_print(CommandIO *io)
+{
+    for (int i = 0; i < COPROC_MAX; i++)
+    {
+        const Coprocess *coprocess = &coprocesses[i];
+        if (coprocess->used)
+        {
+            io_printf(io, "%-16s pid %-8d write fd %-4d read fd %-4d %s\n", coprocess->name, (int)coprocess->pid,
+                      coprocess->requests.output_fd, fileno(coprocess->answers), coprocess->command.arguments[0]);
+        }
+    }
+}
+
+bool coproc_any_running(void)
+{
+    for (int i = 0; i < COPROC_MAX; i++)
+    {
+        if (coprocesses[i].used)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,94 @@
+#ifndef MYSHELL_COPROC_H
+#define MYSHELL_COPROC_H
+
+#include "command.h" // For ParsedInput, CommandResult, CommandIO
+#include <stdbool.h>
+
+// Coprocesses: long-lived helpers (`bc`, `jq`, a lookup tool...) started once
+// and fed one request at a time, instead of forking and exec'ing the helper
+// for every request.
+//
+// A coprocess is known by its name and connected to the shell by two pipes,
+// one to its stdin and one from its stdout. Writes to it are buffered and only
+// sent when the buffer fills up or when its answer is read, so a burst of
+// requests costs a single write. Its answers are read a line at a time
+// through a buffered stream.
+//
+// The shell's ends of the pipes (listed by `coproc`) are inherited by the
+// commands it runs, which can use them directly (`sh -c 'echo 1+1 >&5'`),
+// except by the other coprocesses. The buffers of the builtins are on top of
+// them: what cowrite sent is only written at the next coread, and coread may
+// have read more than the line it printed.
+//
+// The coprocesses still running when the shell exits get their stdin closed,
+// some time to exit, then SIGTERM and finally SIGKILL, and are reaped.
+
+/**
+ * @brief Starts a coprocess.
+ *
+ * @param name    Name to refer to it later on.
+ * @param command External command to run, with its arguments.
+ * @return 0 on success, 1 if the name is taken or invalid, or the coprocess
+ *         could not be started.
+ */
+CommandResult coproc_start(const char *name, const ParsedInput *command);
+
+/**
+ * @brief Writes a line to the stdin of a coprocess: the words, separated by
+ *  spaces, and a newline. It may stay buffered until the next read.
+ *
+ * @param name       Name of the coprocess.
+ * @param word_count Number of words.
+ * @param words      Words of the line.
+ * @return 0 on success, 1 if there is no such coprocess or it stopped reading.
+ */
+CommandResult coproc_write_line(const char *name, int word_count, char *words[]);
+
+/**
+ * @brief Writes everything read from a file descriptor, up to its end, to the
+ *  stdin of a coprocess, as it is. It may stay buffered until the next read.
+ *  Answers that don't fit in the pipe from the coprocess must be read
+ *  meanwhile (by another stage of the pipeline), or it stops reading.
+ *
+ * @param name     Name of the coprocess.
+ * @param input_fd Where the data is read from (the input of the builtin).
+ * @return 0 on success, 1 if there is no such coprocess, it stopped reading or
+ *         the input could not be read.
+ */
+CommandResult coproc_write_input(const char *name, int input_fd);
+
+/**
+ * @brief Reads the next line written by a coprocess. Whatever is buffered for
+ *  it is sent first, since it is usually what the line answers to.
+ *
+ * @param name Name of the coprocess.
+ * @param io   Where the line (with its newline) is written.
+ * @return 0 on success, 1 if there is no such coprocess or it closed its
+ *         output.
+ */
+CommandResult coproc_read_line(const char *name, CommandIO *io);
+
+/**
+ * @brief Closes the stdin of a coprocess, waits for it to exit and forgets it.
+ *
+ * @param name Name of the coprocess.
+ * @return Exit status of the coprocess, 1 if there is no such coprocess.
+ */
+CommandResult coproc_close(const char *name);
+
+/**
+ * @brief Lists the running coprocesses: name, pid and the file descriptors
+ *  the shell uses to talk to them.
+ *
+ * @param io Where the list is written.
+ */
+void coproc_print(CommandIO *io);
+
+/**
+ * @brief Checks whether any coprocess is running.
+ *
+ * @return true if there is at least one coprocess.
+ */
+bool coproc_any_running(void);
+
+#endif // !MYSHELL_COPROC_H
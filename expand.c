@@ -0,0 +1,575 @@
+#include "expand.h"
+#include <ctype.h>  // For isalpha, isdigit
+#include <errno.h>  // For errno, ERANGE
+#include <limits.h> // For LLONG_MIN
+#include <stdio.h>  // For snprintf, fprintf
+#include <stdlib.h> // For malloc, calloc, free, strtoll
+#include <string.h> // For memchr, memcpy, strchr, strdup, strlen
+
+// Most words a command can get from brace expansion, they are all kept in
+// memory (the words fed to a for loop are not limited)
+static const uint64_t EXPAND_MAX_WORDS = 1 << 22;
+
+typedef enum
+{
+    SEGMENT_LITERAL,      // Text copied as is
+    SEGMENT_ALTERNATIVES, // {a,b,c}
+    SEGMENT_NUMBERS,      // {1..10..2}
+    SEGMENT_LETTERS,      // {a..e}
+} SegmentKind;
+
+// A part of the word: either literal text or a brace expression, and where
+// the generation currently is in it
+typedef struct
+{
+    SegmentKind kind;
+    const char *text;  // Literal text, or the alternatives separated by ','
+    size_t length;     // Length of text
+    long long first;   // First number or letter of a range
+    long long step;    // Signed step between numbers or letters
+    int width;         // Zero padded width of the numbers, 0 for none
+    uint64_t size;     // Number of elements
+    uint64_t index;    // Current element
+    long long value;   // Current number or letter
+    size_t offset;     // Offset in text of the current alternative
+} Segment;
+
+// This is the full definition of the struct.
+// It is only visible inside this file (expand.c), hiding it from the user.
+struct Expansion
+{
+    char *word; // Own copy, the segments point into it
+    Segment *segments;
+    int segment_count;
+    uint64_t remaining; // Words not generated yet
+    bool started;
+    char *buffer; // Sized for the longest word
+};
+
+// =================================================================
+// Private helpers
+// =================================================================
+
+/**
+ * @brief Parses a whole integer (with an optional sign). Fails if it does not
+ *  fit in a long long.
+ */
+static bool parse_integer(const char *text, size_t length, long long *value)
+{
+    char number[32];
+    if (length == 0 || length >= sizeof(number))
+    {
+        return false;
+    }
+
+    memcpy(number, text, length);
+    number[length] = '\0';
+
+    char *end = NULL;
+    errno = 0;
+    *value = strtoll(number, &end, 10);
+
+    return errno != ERANGE && end != number && *end == '\0' && (isdigit((unsigned char)number[0]) || number[0] == '-' || number[0] == '+');
+}
+
+/**
+ * @brief Whether a number is written with leading zeros (`08`, `-01`), which
+ *  asks for all the numbers of the range to be zero padded.
+ */
+static bool has_leading_zero(const char *text, size_t length)
+{
+    if (length > 0 && (text[0] == '-' || text[0] == '+'))
+    {
+        text++;
+        length--;
+    }
+
+    return length > 1 && text[0] == '0';
+}
+
+/**
+ * @brief Parses the inside of `{A..B}` or `{A..B..STEP}` as a range.
+ */
+static bool parse_range(const char *text, size_t length, Segment *segment)
+{
+    const char *end = text + length;
+    const char *first_dots = NULL;
+    const char *second_dots = NULL;
+
+    for (const char *p = text; p + 1 < end; p++)
+    {
+        if (p[0] == '.' && p[1] == '.')
+        {
+            if (first_dots == NULL)
+            {
+                first_dots = p;
+                p++;
+            }
+            else if (second_dots == NULL)
+            {
+                second_dots = p;
+                p++;
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+
+    if (first_dots == NULL)
+    {
+        return false;
+    }
+
+    const char *start_text = text;
+    size_t start_length = first_dots - text;
+    const char *stop_text = first_dots + 2;
+    size_t stop_length = (second_dots != NULL ? second_dots : end) - stop_text;
+
+    // A step of LLONG_MIN has no positive counterpart
+    long long step = 1;
+    if (second_dots != NULL && (!parse_integer(second_dots + 2, end - (second_dots + 2), &step) || step == LLONG_MIN))
+    {
+        return false;
+    }
+    if (step < 0)
+    {
+        step = -step;
+    }
+    if (step == 0)
+    {
+        step = 1;
+    }
+
+    long long start;
+    long long stop;
+    if (parse_integer(start_text, start_length, &start) && parse_integer(stop_text, stop_length, &stop))
+    {
+        segment->kind = SEGMENT_NUMBERS;
+        segment->width = 0;
+        if (has_leading_zero(start_text, start_length) || has_leading_zero(stop_text, stop_length))
+        {
+            segment->width = start_length > stop_length ? start_length : stop_length;
+        }
+    }
+    else if (start_length == 1 && stop_length == 1 && isalpha((unsigned char)start_text[0]) &&
+             isalpha((unsigned char)stop_text[0]))
+    {
+        segment->kind = SEGMENT_LETTERS;
+        start = start_text[0];
+        stop = stop_text[0];
+    }
+    else
+    {
+        return false;
+    }
+
+    // Unsigned arithmetic, the distance between two long longs may not fit
+    // in one
+    uint64_t distance = start <= stop ? (uint64_t)stop - (uint64_t)start : (uint64_t)start - (uint64_t)stop;
+
+    // The number of elements would not fit either (2^64 from LLONG_MIN to
+    // LLONG_MAX), the braces stay as they are
+    if (distance / (uint64_t)step == UINT64_MAX)
+    {
+        return false;
+    }
+
+    segment->first = start;
+    segment->step = start <= stop ? step : -step;
+    segment->size = distance / (uint64_t)step + 1;
+
+    return true;
+}
+
+/**
+ * @brief Parses the inside of `{...}` as a brace expression.
+ *
+ * @return false if it is not one, and the braces are literal text.
+ */
+static bool parse_expression(const char *text, size_t length, Segment *segment)
+{
+    segment->index = 0;
+    segment->offset = 0;
+    segment->text = text;
+    segment->length = length;
+
+    if (memchr(text, ',', length) != NULL)
+    {
+        segment->kind = SEGMENT_ALTERNATIVES;
+        segment->size = 1;
+        for (size_t i = 0; i < length; i++)
+        {
+            segment->size += text[i] == ',';
+        }
+        return true;
+    }
+
+    if (parse_range(text, length, segment))
+    {
+        segment->value = segment->first;
+        return true;
+    }
+
+    return false;
+}
+
+static void add_literal(Expansion *expansion, const char *text, size_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+    Segment *segment = &expansion->segments[expansion->segment_count++];
+    segment->kind = SEGMENT_LITERAL;
+    segment->text = text;
+    segment->length = length;
+    segment->size = 1;
+    segment->index = 0;
+}
+
+/**
+ * @brief Length of the longest element of a segment.
+ */
+static size_t segment_max_length(const Segment *segment)
+{
+    size_t longest = 0;
+
+    switch (segment->kind)
+    {
+    case SEGMENT_LITERAL:
+        return segment->length;
+
+    case SEGMENT_ALTERNATIVES:
+        for (size_t start = 0, i = 0; i <= segment->length; i++)
+        {
+            if (i == segment->length || segment->text[i] == ',')
+            {
+                longest = i - start > longest ? i - start : longest;
+                start = i + 1;
+            }
+        }
+        return longest;
+
+    case SEGMENT_NUMBERS:
+    {
+        // The widest numbers are at the ends of the range
+        long long last = (long long)((uint64_t)segment->first + (segment->size - 1) * (uint64_t)segment->step);
+        int first_length = snprintf(NULL, 0, "%0*lld", segment->width, segment->first);
+        int last_length = snprintf(NULL, 0, "%0*lld", segment->width, last);
+        return first_length > last_length ? first_length : last_length;
+    }
+
+    case SEGMENT_LETTERS:
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Moves a segment to its next element, or back to the first one.
+ *
+ * @return false if it went back to the first element.
+ */
+static bool segment_advance(Segment *segment)
+{
+    segment->index++;
+    if (segment->index >= segment->size)
+    {
+        segment->index = 0;
+        segment->value = segment->first;
+        segment->offset = 0;
+        return false;
+    }
+
+    if (segment->kind == SEGMENT_ALTERNATIVES)
+    {
+        const char *comma = memchr(segment->text + segment->offset, ',', segment->length - segment->offset);
+        segment->offset = comma - segment->text + 1;
+    }
+    else
+    {
+        segment->value += segment->step;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Writes the current element of a segment.
+ *
+ * @return Where the element ends in destination.
+ */
+static char *segment_write(const Segment *segment, char *destination)
+{
+    switch (segment->kind)
+    {
+    case SEGMENT_LITERAL:
+        memcpy(destination, segment->text, segment->length);
+        return destination + segment->length;
+
+    case SEGMENT_ALTERNATIVES:
+    {
+        const char *start = segment->text + segment->offset;
+        const char *comma = memchr(start, ',', segment->length - segment->offset);
+        size_t length = comma != NULL ? (size_t)(comma - start) : segment->length - segment->offset;
+        memcpy(destination, start, length);
+        return destination + length;
+    }
+
+    case SEGMENT_NUMBERS:
+        // The buffer was sized with the same format, it can't be truncated
+        return destination + sprintf(destination, "%0*lld", segment->width, segment->value);
+
+    case SEGMENT_LETTERS:
+        *destination = (char)segment->value;
+        return destination + 1;
+    }
+
+    return destination;
+}
+
+// =================================================================
+// Public functions
+// =================================================================
+
+Expansion *expansion_create(const char *word)
+{
+    Expansion *expansion = malloc(sizeof(Expansion));
+    if (expansion == NULL)
+    {
+        return NULL;
+    }
+
+    size_t length = strlen(word);
+    expansion->word = strdup(word);
+    // There can't be more segments than characters (plus one for "")
+    expansion->segments = malloc(sizeof(Segment) * (length + 1));
+    expansion->segment_count = 0;
+    expansion->buffer = NULL;
+    if (expansion->word == NULL || expansion->segments == NULL)
+    {
+        expansion_destroy(expansion);
+        return NULL;
+    }
+
+    const char *text = expansion->word;
+    size_t literal_start = 0;
+    size_t i = 0;
+
+    while (i < length)
+    {
+        const char *closing = text[i] == '{' ? strchr(text + i, '}') : NULL;
+        if (closing == NULL)
+        {
+            i++;
+            continue;
+        }
+
+        // Braces don't nest: with another '{' before the '}', only the inner
+        // one may start an expression
+        const char *inner_opening = memchr(text + i + 1, '{', closing - (text + i + 1));
+        if (inner_opening != NULL)
+        {
+            i = inner_opening - text;
+            continue;
+        }
+
+        Segment segment;
+        if (parse_expression(text + i + 1, closing - (text + i + 1), &segment))
+        {
+            add_literal(expansion, text + literal_start, i - literal_start);
+            expansion->segments[expansion->segment_count++] = segment;
+            i = closing - text + 1;
+            literal_start = i;
+        }
+        else
+        {
+            i++;
+        }
+    }
+    add_literal(expansion, text + literal_start, length - literal_start);
+
+    // The longest word has the longest element of every segment
+    size_t buffer_size = 1;
+    for (int segment = 0; segment < expansion->segment_count; segment++)
+    {
+        buffer_size += segment_max_length(&expansion->segments[segment]);
+    }
+
+    expansion->buffer = malloc(buffer_size);
+    if (expansion->buffer == NULL)
+    {
+        expansion_destroy(expansion);
+        return NULL;
+    }
+
+    expansion->remaining = expansion_count(expansion);
+    expansion->started = false;
+
+    return expansion;
+}
+
+void expansion_destroy(Expansion *expansion)
+{
+    if (expansion == NULL)
+    {
+        return;
+    }
+
+    free(expansion->word);
+    free(expansion->segments);
+    free(expansion->buffer);
+    free(expansion);
+}
+
+uint64_t expansion_count(const Expansion *expansion)
+{
+    // The product of the sizes of the segments
+    uint64_t count = 1;
+    for (int segment = 0; segment < expansion->segment_count; segment++)
+    {
+        uint64_t size = expansion->segments[segment].size;
+        if (count > UINT64_MAX / size)
+        {
+            return UINT64_MAX;
+        }
+        count *= size;
+    }
+
+    return count;
+}
+
+const char *expansion_next(Expansion *expansion)
+{
+    if (expansion->remaining == 0)
+    {
+        return NULL;
+    }
+
+    // Like an odometer: the last segment moves every time, and each one that
+    // goes back to its first element moves the one before it
+    if (expansion->started)
+    {
+        for (int segment = expansion->segment_count - 1; segment >= 0; segment--)
+        {
+            if (segment_advance(&expansion->segments[segment]))
+            {
+                break;
+            }
+        }
+    }
+    expansion->started = true;
+    expansion->remaining--;
+
+    char *end = expansion->buffer;
+    for (int segment = 0; segment < expansion->segment_count; segment++)
+    {
+        end = segment_write(&expansion->segments[segment], end);
+    }
+    *end = '\0';
+
+    return expansion->buffer;
+}
+
+bool expand_needed(const ParsedInput *parsed_input)
+{
+    for (uint i = 0; i < parsed_input->count; i++)
+    {
+        const char *opening = strchr(parsed_input->arguments[i], '{');
+        if (opening != NULL && strchr(opening, '}') != NULL)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool expand_arguments(const ParsedInput *parsed_input, ParsedInput *expanded)
+{
+    expanded->count = 0;
+    expanded->arguments = NULL;
+
+    // First pass: count the words, so the array is allocated only once
+    Expansion **expansions = calloc(parsed_input->count, sizeof(Expansion *));
+    if (parsed_input->count > 0 && expansions == NULL)
+    {
+        perror("myshell: expansion");
+        return false;
+    }
+
+    bool success = true;
+    uint64_t total = 0;
+    for (uint i = 0; i < parsed_input->count && success; i++)
+    {
+        expansions[i] = expansion_create(parsed_input->arguments[i]);
+        if (expansions[i] == NULL)
+        {
+            perror("myshell: expansion");
+            success = false;
+        }
+        else
+        {
+            uint64_t count = expansion_count(expansions[i]);
+            total = count > UINT64_MAX - total ? UINT64_MAX : total + count;
+        }
+    }
+
+    if (success && total > EXPAND_MAX_WORDS)
+    {
+        fprintf(stderr, "myshell: expansion: too many words (more than %llu)\n",
+                (unsigned long long)EXPAND_MAX_WORDS);
+        success = false;
+    }
+
+    // Second pass: generate them
+    if (success)
+    {
+        expanded->arguments = malloc(sizeof(char *) * (total + 1));
+        success = expanded->arguments != NULL;
+        if (!success)
+        {
+            perror("myshell: expansion");
+        }
+    }
+
+    for (uint i = 0; i < parsed_input->count && success; i++)
+    {
+        const char *word;
+        while (success && (word = expansion_next(expansions[i])) != NULL)
+        {
+            expanded->arguments[expanded->count] = strdup(word);
+            success = expanded->arguments[expanded->count] != NULL;
+            expanded->count += success;
+        }
+    }
+
+    if (expanded->arguments != NULL)
+    {
+        expanded->arguments[expanded->count] = NULL;
+    }
+
+    for (uint i = 0; i < parsed_input->count; i++)
+    {
+        expansion_destroy(expansions[i]);
+    }
+    free(expansions);
+
+    if (!success && expanded->arguments != NULL)
+    {
+        perror("myshell: expansion");
+        for (uint i = 0; i < expanded->count; i++)
+        {
+            free(expanded->arguments[i]);
+        }
+        free(expanded->arguments);
+        expanded->arguments = NULL;
+        expanded->count = 0;
+    }
+
+    return success;
+}
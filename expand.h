@@ -0,0 +1,84 @@
+#ifndef MYSHELL_EXPAND_H
+#define MYSHELL_EXPAND_H
+
+#include "command.h" // For ParsedInput
+#include <stdbool.h>
+#include <stdint.h> // For uint64_t
+
+// Brace expansion of words, as in other shells:
+//
+//     {a,b,c}     alternatives         a b c
+//     {1..10..3}  numbers, with step   1 4 7 10
+//     {08..10}    zero padded          08 09 10
+//     {a..e}      letters              a b c d e
+//
+// A word may have several brace expressions, and every combination is
+// generated, the rightmost one varying fastest (`x{a,b}{1,2}` gives xa1 xa2
+// xb1 xb2). Braces don't nest, and braces that are not one of the above stay
+// as they are (`{}`, `{a}`), as do ranges whose numbers or number of elements
+// don't fit in 64 bits.
+//
+// The words of an expansion are generated lazily, one at a time, in a buffer
+// sized for the longest of them: going through `{1..1000000}` takes constant
+// memory. They are only all stored when they become the arguments of a
+// command, see expand_arguments.
+
+// Same approach as Path (see path.h): the generator is an opaque type, only
+// usable through the functions below.
+typedef struct Expansion Expansion;
+
+/**
+ * @brief Prepares the lazy expansion of a word.
+ *
+ * @param word Word to expand. It is copied.
+ * @return A new Expansion (free it with expansion_destroy), or NULL if
+ *         allocation fails.
+ */
+Expansion *expansion_create(const char *word);
+
+/**
+ * @brief Frees all memory associated with an Expansion.
+ *
+ * @param expansion The Expansion to destroy, may be NULL.
+ */
+void expansion_destroy(Expansion *expansion);
+
+/**
+ * @brief Gets the number of words of the expansion, without generating them.
+ *
+ * @param expansion The Expansion.
+ * @return The number of words (1 for a word without braces), UINT64_MAX if it
+ *         does not fit.
+ */
+uint64_t expansion_count(const Expansion *expansion);
+
+/**
+ * @brief Generates the next word of the expansion.
+ *
+ * @param expansion The Expansion.
+ * @return The next word, valid until the next call or expansion_destroy, or
+ *         NULL once all of them were generated.
+ */
+const char *expansion_next(Expansion *expansion);
+
+/**
+ * @brief Checks whether any of the words has a brace expression to expand.
+ *
+ * @param parsed_input Words to check.
+ * @return true if expand_arguments would change them.
+ */
+bool expand_needed(const ParsedInput *parsed_input);
+
+/**
+ * @brief Expands all the words of a command into a new ParsedInput. Its
+ *  arguments array is allocated once, with the exact number of words.
+ *
+ * @param parsed_input Words to expand.
+ * @param expanded     Where the result is stored, to be released with
+ *                     parsed_input_destroy.
+ * @return true on success, false if the expansion is too large or allocation
+ *         fails (an error is printed).
+ */
+bool expand_arguments(const ParsedInput *parsed_input, ParsedInput *expanded);
+
+#endif // !MYSHELL_EXPAND_H
@@ -0,0 +1,528 @@
+#include "frecency.h"
+#include "io.h"        // For io_printf
+#include <errno.h>     // For errno, EEXIST
+#include <fcntl.h>     // For open
+#include <math.h>      // For pow
+#include <stdint.h>    // For uint32_t, int64_t
+#include <stdio.h>     // For snprintf, fprintf
+#include <stdlib.h>    // For getenv, qsort
+#include <string.h>    // For memcmp, strlen, strrchr
+#include <strings.h>   // For strncasecmp
+#include <sys/file.h>  // For flock
+#include <sys/mman.h>  // For mmap
+#include <sys/stat.h>  // For stat, mkdir
+#include <time.h>      // For time
+#include <unistd.h>    // For ftruncate, getcwd
+
+// Array sizes must be integer constant expressions in C, so an enum is used
+// here instead of `static const`.
+enum
+{
+    FRECENCY_CAPACITY = 1024,         // Records in the database
+    FRECENCY_PATH_LENGTH = 246,       // Longest path stored, '\0' included
+    FRECENCY_FILE_PATH_LENGTH = 4096, // Longest path of the database file
+};
+
+// Name of the environment variable that overrides the database path
+static const char *FRECENCY_FILE_ENV = "JOSH_FRECENCY_FILE";
+
+static const uint32_t FRECENCY_MAGIC = 0x6a667263; // "jfrc"
+static const uint32_t FRECENCY_VERSION = 1;
+
+// The ranks are aged once per period, and whenever they add up to more than
+// FRECENCY_MAX_TOTAL_RANK
+static const double FRECENCY_MAX_TOTAL_RANK = 10000;
+static const double FRECENCY_AGING_FACTOR = 0.9;
+static const int64_t FRECENCY_AGING_PERIOD_SECONDS = 24 * 3600;
+
+// Records whose rank falls under this after aging are forgotten
+static const double FRECENCY_MIN_RANK = 1;
+
+static const uint32_t SECONDS_PER_HOUR = 3600;
+
+// On-disk layout. Both structs have a fixed size (32 and 256 bytes), with no
+// padding, so the file is the same for every build on the same architecture.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;    // Records in use, always the first ones
+    uint32_t capacity; // Records in the file
+    double total_rank; // Sum of the ranks of all the records
+    int64_t last_aged; // When the ranks were last aged by the period
+} FrecencyHeader;
+
+typedef struct
+{
+    float rank;           // Number of visits, aged over time
+    uint32_t last_access; // Time of the last visit
+    uint16_t length;      // Length of path
+    char path[FRECENCY_PATH_LENGTH];
+} FrecencyRecord;
+
+typedef struct
+{
+    FrecencyHeader header;
+    FrecencyRecord records[];
+} FrecencyDatabase;
+
+// The mapping is done once, on first use, and kept for the whole session
+static FrecencyDatabase *database = NULL;
+static int database_fd = -1;
+static bool database_unavailable = false;
+
+// =================================================================
+// Private helpers
+// =================================================================
+
+static bool make_directory(const char *path)
+{
+    return mkdir(path, 0700) == 0 || errno == EEXIST;
+}
+
+static bool frecency_file_path(char path[FRECENCY_FILE_PATH_LENGTH])
+{
+    const char *override = getenv(FRECENCY_FILE_ENV);
+    const char *xdg_data = getenv("XDG_DATA_HOME");
+    const char *home = getenv("HOME");
+    char directory[FRECENCY_FILE_PATH_LENGTH];
+
+    if (override != NULL && override[0] != '\0')
+    {
+        return snprintf(path, FRECENCY_FILE_PATH_LENGTH, "%s", override) < FRECENCY_FILE_PATH_LENGTH;
+    }
+
+    if (xdg_data != NULL && xdg_data[0] != '\0')
+    {
+        snprintf(directory, sizeof(directory), "%s/josh", xdg_data);
+        make_directory(xdg_data);
+    }
+    else if (home != NULL)
+    {
+        // ~/.local/share/josh, creating every missing level
+        snprintf(directory, sizeof(directory), "%s/.local", home);
+        make_directory(directory);
+        snprintf(directory, sizeof(directory), "%s/.local/share", home);
+        make_directory(directory);
+        snprintf(directory, sizeof(directory), "%s/.local/share/josh", home);
+    }
+    else
+    {
+        return false;
+    }
+
+    if (!make_directory(directory))
+    {
+        return false;
+    }
+
+    return snprintf(path, FRECENCY_FILE_PATH_LENGTH, "%s/frecency.db", directory) < FRECENCY_FILE_PATH_LENGTH;
+}
+
+/**
+ * @brief Checks that a mapped file is a database this shell can use: the
+ *  header, and every record in use, whose path must fit and be terminated
+ *  (paths are used as C strings). The database must be locked.
+ */
+static bool frecency_valid(const FrecencyDatabase *mapped)
+{
+    const FrecencyHeader *header = &mapped->header;
+
+    if (header->magic != FRECENCY_MAGIC || header->version != FRECENCY_VERSION ||
+        header->capacity != FRECENCY_CAPACITY || header->count > FRECENCY_CAPACITY)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->count; i++)
+    {
+        const FrecencyRecord *record = &mapped->records[i];
+        if (record->length >= sizeof(record->path) || record->path[record->length] != '\0')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Maps the database in memory, creating it if needed.
+ *
+ * @return true if the database can be used.
+ */
+static bool frecency_open(void)
+{
+    if (database != NULL)
+    {
+        return true;
+    }
+    if (database_unavailable)
+    {
+        return false; // Don't retry (and complain) on every cd
+    }
+
+    database_unavailable = true;
+
+    char path[FRECENCY_FILE_PATH_LENGTH];
+    if (!frecency_file_path(path))
+    {
+        return false;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1)
+    {
+        perror("myshell: frecency");
+        return false;
+    }
+
+    const size_t size = sizeof(FrecencyHeader) + sizeof(FrecencyRecord) * FRECENCY_CAPACITY;
+
+    // A new (empty) file gets its full size right away, reads as zeros
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || ((size_t)file_stat.st_size < size && ftruncate(fd, size) == -1))
+    {
+        perror("myshell: frecency");
+        close(fd);
+        return false;
+    }
+
+    FrecencyDatabase *mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        perror("myshell: frecency");
+        close(fd);
+        return false;
+    }
+
+    flock(fd, LOCK_EX);
+    if (!frecency_valid(mapped))
+    {
+        // New, unknown or corrupted file: start from scratch
+        if (mapped->header.magic != 0)
+        {
+            fprintf(stderr, "myshell: frecency: %s: unusable database, starting over\n", path);
+        }
+        memset(mapped, 0, size);
+        mapped->header.magic = FRECENCY_MAGIC;
+        mapped->header.version = FRECENCY_VERSION;
+        mapped->header.capacity = FRECENCY_CAPACITY;
+        mapped->header.last_aged = time(NULL);
+    }
+    flock(fd, LOCK_UN);
+
+    database = mapped;
+    database_fd = fd;
+    database_unavailable = false;
+
+    return true;
+}
+
+/**
+ * @brief Scales all the ranks down by `factor` and forgets the records whose
+ *  rank becomes too low. The database must be locked.
+ */
+static void frecency_age(double factor)
+{
+    FrecencyHeader *header = &database->header;
+    uint32_t kept = 0;
+    double total = 0;
+
+    for (uint32_t i = 0; i < header->count; i++)
+    {
+        FrecencyRecord *record = &database->records[i];
+        record->rank *= factor;
+
+        if (record->rank >= FRECENCY_MIN_RANK)
+        {
+            if (kept != i)
+            {
+                database->records[kept] = *record;
+            }
+            total += record->rank;
+            kept++;
+        }
+    }
+
+    header->count = kept;
+    header->total_rank = total;
+}
+
+/**
+ * @brief Ages the ranks once for every period elapsed since they were last
+ *  aged that way, so that directories no longer visited fade out even when the
+ *  total rank stays low. The database must be locked.
+ */
+static void frecency_age_periodically(time_t now)
+{
+    FrecencyHeader *header = &database->header;
+
+    // The clock went back: start the period over
+    if (now < header->last_aged)
+    {
+        header->last_aged = now;
+        return;
+    }
+
+    int64_t periods = (now - header->last_aged) / FRECENCY_AGING_PERIOD_SECONDS;
+    if (periods > 0)
+    {
+        frecency_age(pow(FRECENCY_AGING_FACTOR, (double)periods));
+        header->last_aged += periods * FRECENCY_AGING_PERIOD_SECONDS;
+    }
+}
+
+/**
+ * @brief Removes a record, moving the last one into its place. The database
+ *  must be locked.
+ */
+static void frecency_remove(uint32_t index)
+{
+    FrecencyHeader *header = &database->header;
+
+    header->total_rank -= database->records[index].rank;
+    header->count--;
+    if (index != header->count)
+    {
+        database->records[index] = database->records[header->count];
+    }
+}
+
+/**
+ * @brief Score of a record: its rank weighted by how recent its last visit is.
+ */
+static double frecency_score(const FrecencyRecord *record, time_t now)
+{
+    time_t age = now - (time_t)record->last_access;
+
+    if (age < SECONDS_PER_HOUR)
+    {
+        return record->rank * 4;
+    }
+    if (age < SECONDS_PER_HOUR * 24)
+    {
+        return record->rank * 2;
+    }
+    if (age < SECONDS_PER_HOUR * 24 * 7)
+    {
+        return record->rank / 2;
+    }
+    return record->rank / 4;
+}
+
+/**
+ * @brief Finds `needle` in the first `length` bytes of `haystack`, ignoring
+ *  case.
+ *
+ * @return Offset right after the match, or -1 if not found.
+ */
+static int find_ignoring_case(const char *haystack, int length, const char *needle)
+{
+    int needle_length = strlen(needle);
+
+    for (int i = 0; i + needle_length <= length; i++)
+    {
+        if (!strncasecmp(haystack + i, needle, needle_length))
+        {
+            return i + needle_length;
+        }
+    }
+
+    return -1;
+}
+
+static bool frecency_matches(const FrecencyRecord *record, char *keywords[], int keyword_count)
+{
+    if (keyword_count == 0)
+    {
+        return true;
+    }
+
+    // Every keyword but the last one, in order, anywhere in the path
+    int offset = 0;
+    for (int i = 0; i < keyword_count - 1; i++)
+    {
+        int end = find_ignoring_case(record->path + offset, record->length - offset, keywords[i]);
+        if (end == -1)
+        {
+            return false;
+        }
+        offset += end;
+    }
+
+    // The last keyword has to be in the last component of the path
+    const char *last_slash = strrchr(record->path, '/');
+    int last_component_start = last_slash != NULL ? last_slash - record->path + 1 : 0;
+    if (offset < last_component_start)
+    {
+        offset = last_component_start;
+    }
+
+    return find_ignoring_case(record->path + offset, record->length - offset, keywords[keyword_count - 1]) != -1;
+}
+
+// =================================================================
+// Public functions
+// =================================================================
+
+void frecency_record(const char *absolute_path)
+{
+    size_t length = strlen(absolute_path);
+
+    if (length >= FRECENCY_PATH_LENGTH)
+    {
+        fprintf(stderr, "myshell: frecency: %s: path too long to be recorded (max %d bytes)\n", absolute_path,
+                FRECENCY_PATH_LENGTH - 1);
+        return;
+    }
+    if (!frecency_open())
+    {
+        return;
+    }
+
+    flock(database_fd, LOCK_EX);
+
+    FrecencyHeader *header = &database->header;
+    time_t now = time(NULL);
+    FrecencyRecord *record = NULL;
+
+    frecency_age_periodically(now);
+
+    for (uint32_t i = 0; i < header->count && record == NULL; i++)
+    {
+        if (database->records[i].length == length && !memcmp(database->records[i].path, absolute_path, length))
+        {
+            record = &database->records[i];
+        }
+    }
+
+    if (record == NULL)
+    {
+        if (header->count < header->capacity)
+        {
+            record = &database->records[header->count++];
+        }
+        else
+        {
+            // Full: the directory with the lowest score makes room
+            uint32_t lowest = 0;
+            for (uint32_t i = 1; i < header->count; i++)
+            {
+                if (frecency_score(&database->records[i], now) < frecency_score(&database->records[lowest], now))
+                {
+                    lowest = i;
+                }
+            }
+            record = &database->records[lowest];
+            header->total_rank -= record->rank;
+        }
+
+        record->rank = 0;
+        record->length = length;
+        memcpy(record->path, absolute_path, length + 1);
+    }
+
+    record->rank += 1;
+    record->last_access = (uint32_t)now;
+    header->total_rank += 1;
+
+    if (header->total_rank > FRECENCY_MAX_TOTAL_RANK)
+    {
+        frecency_age(FRECENCY_AGING_FACTOR);
+    }
+
+    flock(database_fd, LOCK_UN);
+}
+
+bool frecency_query(char *keywords[], int keyword_count, char *match, size_t match_size)
+{
+    if (!frecency_open())
+    {
+        return false;
+    }
+
+    char *cwd = getcwd(NULL, 0);
+    time_t now = time(NULL);
+    bool found = false;
+
+    flock(database_fd, LOCK_EX);
+
+    while (!found)
+    {
+        FrecencyHeader *header = &database->header;
+        int64_t best = -1;
+        double best_score = 0;
+
+        for (uint32_t i = 0; i < header->count; i++)
+        {
+            const FrecencyRecord *record = &database->records[i];
+            double score = frecency_score(record, now);
+
+            if (score > best_score && frecency_matches(record, keywords, keyword_count) &&
+                (cwd == NULL || strcmp(record->path, cwd) != 0))
+            {
+                best = i;
+                best_score = score;
+            }
+        }
+
+        if (best == -1)
+        {
+            break;
+        }
+
+        // Directories that were removed are forgotten, then search again
+        struct stat file_stat;
+        if (stat(database->records[best].path, &file_stat) != 0 || !S_ISDIR(file_stat.st_mode))
+        {
+            frecency_remove(best);
+            continue;
+        }
+
+        snprintf(match, match_size, "%s", database->records[best].path);
+        found = true;
+    }
+
+    flock(database_fd, LOCK_UN);
+    free(cwd);
+
+    return found;
+}
+
+static int compare_scores_ascending(const void *a, const void *b)
+{
+    const double *first = a;
+    const double *second = b;
+
+    return (first[0] > second[0]) - (first[0] < second[0]);
+}
+
+void frecency_print(CommandIO *io)
+{
+    if (!frecency_open())
+    {
+        return;
+    }
+
+    // Pairs of (score, index), sorted by score
+    double scored[FRECENCY_CAPACITY][2];
+    time_t now = time(NULL);
+
+    flock(database_fd, LOCK_SH);
+
+    uint32_t count = database->header.count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        scored[i][0] = frecency_score(&database->records[i], now);
+        scored[i][1] = i;
+    }
+    qsort(scored, count, sizeof(scored[0]), compare_scores_ascending);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        io_printf(io, "%10.1f  %s\n", scored[i][0], database->records[(uint32_t)scored[i][1]].path);
+    }
+
+    flock(database_fd, LOCK_UN);
+}
@@ -0,0 +1,56 @@
+#ifndef MYSHELL_FRECENCY_H
+#define MYSHELL_FRECENCY_H
+
+#include <stdbool.h>
+#include <stddef.h> // For size_t
+
+#include "command.h" // For CommandIO
+
+// Database of the directories visited with `cd`, ranked by "frecency" (how
+// often and how recently they were visited), used to jump to a directory from
+// a few fragments of its path (`cd -j` and `j`).
+//
+// The database is a fixed size file of fixed size records, mapped in memory
+// and updated in place, so recording a visit or answering a query never reads
+// or writes more than the records involved. Ranks are aged (scaled down, and
+// the forgotten entries dropped) once a day, and whenever their total grows
+// too large.
+//
+// It lives in $JOSH_FRECENCY_FILE, $XDG_DATA_HOME/josh/frecency.db or
+// ~/.local/share/josh/frecency.db. A file that is not a valid database is
+// started over.
+//
+// Paths are stored in the records themselves, so directories whose path is
+// longer than 245 bytes are not recorded (a message says so).
+
+/**
+ * @brief Records a visit to a directory, unless its path is too long for a
+ *  record (an error is printed then).
+ *
+ * @param absolute_path Absolute path of the directory.
+ */
+void frecency_record(const char *absolute_path);
+
+/**
+ * @brief Finds the best ranked directory that matches all the keywords. They
+ *  have to appear in the path in the given order (case insensitively) and the
+ *  last one has to be in the last component of the path. Directories that no
+ *  longer exist are forgotten, and the current directory is never returned.
+ *
+ * @param keywords      Fragments of the path to look for.
+ * @param keyword_count Number of keywords.
+ * @param match         Where the matching path is written.
+ * @param match_size    Size in bytes of match.
+ * @return true if a directory matched, false otherwise.
+ */
+bool frecency_query(char *keywords[], int keyword_count, char *match, size_t match_size);
+
+/**
+ * @brief Prints every directory of the database with its current score, the
+ *  best ones last (closest to the prompt).
+ *
+ * @param io Where the directories are written.
+ */
+void frecency_print(CommandIO *io);
+
+#endif // !MYSHELL_FRECENCY_H
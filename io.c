@@ -0,0 +1,118 @@
+#include "io.h"
+#include <errno.h>  // For errno, EINTR
+#include <stdarg.h> // For va_list
+#include <stdio.h>  // For vsnprintf
+#include <stdlib.h> // For malloc, free
+#include <string.h> // For memcpy
+#include <unistd.h> // For write
+
+/**
+ * @brief Writes all the bytes to a file descriptor, retrying short writes.
+ */
+static bool write_all(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+void io_init(CommandIO *io, int input_fd, int output_fd)
+{
+    io->input_fd = input_fd;
+    io->output_fd = output_fd;
+    io->used = 0;
+    io->failed = false;
+}
+
+bool io_flush(CommandIO *io)
+{
+    if (io->used > 0 && !io->failed)
+    {
+        io->failed = !write_all(io->output_fd, io->buffer, io->used);
+    }
+    io->used = 0;
+
+    return !io->failed;
+}
+
+bool io_write(CommandIO *io, const void *data, size_t size)
+{
+    if (io->failed)
+    {
+        return false;
+    }
+
+    // Fits in what is left of the buffer
+    if (size <= sizeof(io->buffer) - io->used)
+    {
+        memcpy(io->buffer + io->used, data, size);
+        io->used += size;
+        return true;
+    }
+
+    if (!io_flush(io))
+    {
+        return false;
+    }
+
+    // Fits in the (now empty) buffer, otherwise it goes straight out
+    if (size < sizeof(io->buffer))
+    {
+        memcpy(io->buffer, data, size);
+        io->used = size;
+        return true;
+    }
+
+    io->failed = !write_all(io->output_fd, data, size);
+    return !io->failed;
+}
+
+bool io_printf(CommandIO *io, const char *format, ...)
+{
+    char line[512];
+    va_list arguments;
+
+    va_start(arguments, format);
+    int length = vsnprintf(line, sizeof(line), format, arguments);
+    va_end(arguments);
+
+    if (length < 0)
+    {
+        return false;
+    }
+
+    if ((size_t)length < sizeof(line))
+    {
+        return io_write(io, line, length);
+    }
+
+    // Too long for the stack buffer, format it again on the heap
+    char *long_line = malloc(length + 1);
+    if (long_line == NULL)
+    {
+        return false;
+    }
+
+    va_start(arguments, format);
+    vsnprintf(long_line, length + 1, format, arguments);
+    va_end(arguments);
+
+    bool written = io_write(io, long_line, length);
+    free(long_line);
+
+    return written;
+}
@@ -0,0 +1,45 @@
+#ifndef MYSHELL_IO_H
+#define MYSHELL_IO_H
+
+#include "command.h" // For CommandIO
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Prepares the streams of a command.
+ *
+ * @param io        CommandIO to initialize.
+ * @param input_fd  File descriptor the command reads from.
+ * @param output_fd File descriptor the command writes to.
+ */
+void io_init(CommandIO *io, int input_fd, int output_fd);
+
+/**
+ * @brief Writes data to the output of a command. It is buffered, and only
+ *  reaches output_fd when the buffer fills up or on io_flush.
+ *
+ * @param io   Streams of the command.
+ * @param data Bytes to write.
+ * @param size Number of bytes to write.
+ * @return true on success, false if the output can't be written anymore.
+ */
+bool io_write(CommandIO *io, const void *data, size_t size);
+
+/**
+ * @brief printf-like formatted write to the output of a command.
+ *
+ * @param io     Streams of the command.
+ * @param format printf format string.
+ * @return true on success, false if the output can't be written anymore.
+ */
+bool io_printf(CommandIO *io, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Writes everything buffered to output_fd.
+ *
+ * @param io Streams of the command.
+ * @return true on success, false if the output can't be written anymore.
+ */
+bool io_flush(CommandIO *io);
+
+#endif // !MYSHELL_IO_H
@@ -0,0 +1,289 @@
+#include "loop.h"
+#include "expand.h" // For expansion_create, expansion_next
+#include <ctype.h>  // For isalpha, isalnum
+#include <signal.h> // For sig_atomic_t
+#include <stddef.h> // For ptrdiff_t
+#include <stdio.h>  // For fprintf, perror
+#include <stdlib.h> // For malloc, realloc, free
+#include <string.h> // For strchr, strncmp, strndup, strtok_r
+
+// Array sizes must be integer constant expressions in C, so an enum is used
+// here instead of `static const`.
+enum
+{
+    LOOP_NAME_LENGTH = 64, // Longest name of the loop variable, '\0' included
+};
+
+// Exit status of a line that is not a valid loop (same as bash's syntax errors)
+static const CommandResult LOOP_SYNTAX_ERROR_STATUS = 2;
+
+static const char *LOOP_BLANKS = " \t";
+
+// Set by loop_interrupt, checked before every iteration
+static volatile sig_atomic_t interrupted = 0;
+
+// The parts of a `for NAME in WORD...; do COMMAND;... done` line
+typedef struct
+{
+    char name[LOOP_NAME_LENGTH];
+    size_t name_length;
+    char *words; // The WORD... part, heap allocated
+    char *body;  // The COMMAND;... part, heap allocated
+} ForLoop;
+
+// =================================================================
+// Private helpers
+// =================================================================
+
+static const char *skip_blanks(const char *text)
+{
+    return text + strspn(text, LOOP_BLANKS);
+}
+
+/**
+ * @brief Whether `text` starts with the whole word `word` (followed by a
+ *  blank, a ';' or the end of the line).
+ */
+static bool starts_with_word(const char *text, const char *word)
+{
+    size_t length = strlen(word);
+    return !strncmp(text, word, length) &&
+           (text[length] == '\0' || text[length] == ';' || strchr(LOOP_BLANKS, text[length]) != NULL);
+}
+
+static bool is_name_character(char character)
+{
+    return isalnum((unsigned char)character) || character == '_';
+}
+
+static bool loop_parse(const char *line, ForLoop *loop)
+{
+    loop->words = NULL;
+    loop->body = NULL;
+
+    const char *position = skip_blanks(line) + strlen("for");
+    position = skip_blanks(position);
+
+    // NAME
+    loop->name_length = 0;
+    if (!isalpha((unsigned char)*position) && *position != '_')
+    {
+        return false;
+    }
+    while (is_name_character(position[loop->name_length]))
+    {
+        loop->name_length++;
+    }
+    if (loop->name_length >= LOOP_NAME_LENGTH)
+    {
+        return false;
+    }
+    memcpy(loop->name, position, loop->name_length);
+    loop->name[loop->name_length] = '\0';
+    position = skip_blanks(position + loop->name_length);
+
+    // in WORD...;
+    if (!starts_with_word(position, "in"))
+    {
+        return false;
+    }
+    position += strlen("in");
+    const char *words_end = strchr(position, ';');
+    if (words_end == NULL)
+    {
+        return false;
+    }
+
+    // do COMMAND;... done
+    const char *body = skip_blanks(words_end + 1);
+    if (!starts_with_word(body, "do"))
+    {
+        return false;
+    }
+    body += strlen("do");
+
+    const char *body_end = body + strlen(body);
+    while (body_end > body && strchr(LOOP_BLANKS, body_end[-1]) != NULL)
+    {
+        body_end--;
+    }
+    size_t done_length = strlen("done");
+    if (body_end - body < (ptrdiff_t)done_length || strncmp(body_end - done_length, "done", done_length) != 0)
+    {
+        return false;
+    }
+    body_end -= done_length;
+    while (body_end > body && strchr(LOOP_BLANKS, body_end[-1]) != NULL)
+    {
+        body_end--;
+    }
+    if (body_end == body || body_end[-1] != ';')
+    {
+        return false;
+    }
+
+    loop->words = strndup(position, words_end - position);
+    loop->body = strndup(body, body_end - body);
+
+    return loop->words != NULL && loop->body != NULL;
+}
+
+/**
+ * @brief Whether `text` (a `$` and what follows it) refers to the variable.
+ *
+ * @return Length of the reference ($NAME or ${NAME}), 0 if it is not one.
+ */
+static size_t variable_reference_length(const char *text, const ForLoop *loop)
+{
+    const char *name = text + 1;
+
+    if (*name == '{')
+    {
+        name++;
+        if (!strncmp(name, loop->name, loop->name_length) && name[loop->name_length] == '}')
+        {
+            return loop->name_length + 3;
+        }
+        return 0;
+    }
+
+    if (!strncmp(name, loop->name, loop->name_length) && !is_name_character(name[loop->name_length]))
+    {
+        return loop->name_length + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Writes the command with every reference to the variable replaced by
+ *  its value. The buffer only grows when a longer command is needed, so the
+ *  loop reuses it from one iteration to the next.
+ *
+ * @return false if the buffer could not be grown.
+ */
+static bool substitute(const char *command, size_t command_length, const ForLoop *loop, const char *value,
+                       char **buffer, size_t *capacity)
+{
+    size_t value_length = strlen(value);
+
+    // Exact size first
+    size_t length = 0;
+    for (size_t i = 0; i < command_length;)
+    {
+        size_t reference_length = command[i] == '$' ? variable_reference_length(command + i, loop) : 0;
+        length += reference_length > 0 ? value_length : 1;
+        i += reference_length > 0 ? reference_length : 1;
+    }
+
+    if (length + 1 > *capacity)
+    {
+        char *grown = realloc(*buffer, length + 1);
+        if (grown == NULL)
+        {
+            return false;
+        }
+        *buffer = grown;
+        *capacity = length + 1;
+    }
+
+    char *end = *buffer;
+    for (size_t i = 0; i < command_length;)
+    {
+        size_t reference_length = command[i] == '$' ? variable_reference_length(command + i, loop) : 0;
+        if (reference_length > 0)
+        {
+            memcpy(end, value, value_length);
+            end += value_length;
+            i += reference_length;
+        }
+        else
+        {
+            *end++ = command[i++];
+        }
+    }
+    *end = '\0';
+
+    return true;
+}
+
+// =================================================================
+// Public functions
+// =================================================================
+
+bool loop_is_for(const char *line)
+{
+    return starts_with_word(skip_blanks(line), "for");
+}
+
+CommandResult loop_run_for(const char *line, LoopCommandRunner *run)
+{
+    ForLoop loop;
+    if (!loop_parse(line, &loop))
+    {
+        fprintf(stderr, "myshell: for: usage: for NAME in WORD...; do COMMAND; [COMMAND;]... done\n");
+        free(loop.words);
+        free(loop.body);
+        return LOOP_SYNTAX_ERROR_STATUS;
+    }
+
+    CommandResult result = 0;
+    char *command = NULL;
+    size_t command_capacity = 0;
+    bool failed = false;
+
+    interrupted = 0;
+
+    char *save_pointer = NULL;
+    for (char *word = strtok_r(loop.words, LOOP_BLANKS, &save_pointer); word != NULL && !interrupted && !failed;
+         word = strtok_r(NULL, LOOP_BLANKS, &save_pointer))
+    {
+        // One word of the expansion at a time, never the whole list
+        Expansion *expansion = expansion_create(word);
+        if (expansion == NULL)
+        {
+            perror("myshell: for");
+            failed = true;
+            break;
+        }
+
+        const char *value;
+        while (!interrupted && !failed && (value = expansion_next(expansion)) != NULL)
+        {
+            // Every command of the body, up to each ';'
+            for (const char *start = loop.body; *start != '\0' && !interrupted;)
+            {
+                const char *end = strchr(start, ';');
+                size_t length = end != NULL ? (size_t)(end - start) : strlen(start);
+
+                if (!substitute(start, length, &loop, value, &command, &command_capacity))
+                {
+                    perror("myshell: for");
+                    failed = true;
+                    break;
+                }
+
+                // Skip the empty commands (`;;`)
+                if (*skip_blanks(command) != '\0')
+                {
+                    result = run(command);
+                }
+
+                start += length + (end != NULL);
+            }
+        }
+
+        expansion_destroy(expansion);
+    }
+
+    free(command);
+    free(loop.words);
+    free(loop.body);
+
+    return failed ? 1 : result;
+}
+
+void loop_interrupt(void)
+{
+    interrupted = 1;
+}
@@ -0,0 +1,48 @@
+#ifndef MYSHELL_LOOP_H
+#define MYSHELL_LOOP_H
+
+#include "command.h" // For CommandResult
+#include <stdbool.h>
+
+// The `for` loop, on a single line:
+//
+//     for NAME in WORD...; do COMMAND; [COMMAND;]... done
+//
+// Each WORD is brace expanded (see expand.h) and the commands run once per
+// resulting word, with $NAME and ${NAME} replaced by it. The words are
+// generated one at a time as the loop goes, so `for i in {1..1000000}` runs in
+// constant memory. Loops don't nest.
+
+/**
+ * @brief Format of the function that runs the commands of the loop body.
+ *
+ * @param command Line of the command, with the loop variable substituted.
+ * @return Exit status of the command.
+ */
+typedef CommandResult LoopCommandRunner(const char *command);
+
+/**
+ * @brief Checks whether a line is a for loop (it starts with the word `for`).
+ *
+ * @param line Line to check.
+ * @return true if the line must be run with loop_run_for.
+ */
+bool loop_is_for(const char *line);
+
+/**
+ * @brief Runs a for loop.
+ *
+ * @param line Whole line of the loop.
+ * @param run  Function that runs each command of the body.
+ * @return Exit status of the last command run (0 if none ran), or 2 if the
+ *         line is not a valid loop.
+ */
+CommandResult loop_run_for(const char *line, LoopCommandRunner *run);
+
+/**
+ * @brief Makes the running loop stop before its next iteration. Safe to call
+ *  from a signal handler (e.g. on Ctrl+C).
+ */
+void loop_interrupt(void);
+
+#endif // !MYSHELL_LOOP_H
@@ -2,7 +2,16 @@
 #include "command.h"   // For ParsedInput
 #include "config.h"    // For the shell configuration
 #include "constants.h" // For constants
+#include "coproc.h"    // For coproc_any_running
+#include "expand.h"    // For expand_needed, expand_arguments
+#include "io.h"        // For io_init
+#include "loop.h"      // For loop_is_for, loop_run_for
+#include "parser.h"    // For parse_arguments
+#include "pipeline.h"  // For pipeline_count_stages, pipeline_run
 #include "process.h"
+#include "prompt.h"    // For print_prompt
+#include "timing.h"    // For timing_now, timing_phase_add
+#include "trace.h"     // For trace_begin, trace_end
 #include <dirent.h>    // For opendir, readdir
 #include <signal.h>    // For signal(capture Ctrl+C)
 #include <stdbool.h>   // For bool
@@ -11,7 +20,9 @@
 #include <stdio.h>     // For printf, scanf, etc.
 #include <stdlib.h>    // For malloc, free, exit, getenv
 #include <string.h>    // For strcmp, strtok
+#include <sys/resource.h> // For getrusage, struct rusage
 #include <sys/stat.h>  // For stat
+#include <sys/time.h>  // For struct timeval
 #include <sys/types.h> // For uint
 #include <sys/wait.h>  // For waitpid
 #include <unistd.h>    // For fork, exec, chdir
@@ -40,23 +51,79 @@ void sigint_handler(int sig);
  * @brief Process a command
  *
  * @param command Command to process
+ * @param in_tail_position Whether nothing else will run after this command
+ *  (last command of a script or -c string). If so, an external command may
+ *  replace the shell instead of being forked, see can_exec_in_place.
  * @return Exit status of the command
  */
-int process_input(const char *command);
+int process_input(const char *command, bool in_tail_position);
 
 /**
- * @brief Read-Eval-Print Loop (REPL) for the shell
+ * @brief Run one command of the body of a for loop
  *
- * @return Exit code passed to the exit command
+ * @param command Command to run, with the loop variable already substituted
+ * @return Exit status of the command
  */
-int read_eval_print_loop();
+CommandResult run_loop_command(const char *command);
 
 /**
- * @brief Print the shell prompt
+ * @brief Check whether a command in tail position can be run by exec'ing it
+ *  in the shell's own process, saving a fork and a wait.
  *
- * @param last_result Last result of the last command executed
+ * @param parsed_command Command to check, arguments[0] must not be NULL
+ * @return true if the shell has no work left that would be lost by the exec
+ */
+bool can_exec_in_place(const ParsedInput *parsed_command);
+
+/**
+ * @brief Run every line of a script (or of a -c string) as a command. The last
+ *  command is run in tail position.
+ *
+ * @param script Stream the lines are read from
+ * @return Exit status of the last command
+ */
+int run_script(FILE *script);
+
+/**
+ * @brief Store in `usage` what the shell and its children consumed since the
+ *  given measures were taken.
+ *
+ * @param self_before RUSAGE_SELF taken at the start
+ * @param children_before RUSAGE_CHILDREN taken at the start
+ * @param usage Where the difference is stored
+ */
+void usage_since(const struct rusage *self_before, const struct rusage *children_before, struct rusage *usage);
+
+/**
+ * @brief Execute an already parsed command, either a builtin, an external
+ *  program or a pipeline, accounting the lookup/builtin/spawn/wait phases.
+ *
+ * @param parsed_command Command to execute, arguments[0] must not be NULL
+ * @param usage Where the resources consumed by the command are stored, may be
+ *  NULL
+ * @return Exit status of the command
  */
-void print_prompt(const int last_result);
+int execute_command(const ParsedInput *parsed_command, struct rusage *usage);
+
+/**
+ * @brief Implementation of the `time [-v] command` reserved word. Runs the
+ *  command and reports to stderr the wall, user and sys time, max RSS and
+ *  context switches. With -v the shell overhead is also broken down by phase.
+ *  The max RSS of builtins and pipelines is the shell's own peak since it
+ *  started, which the output says.
+ *
+ * @param parsed_command Full input, including the `time` word itself
+ * @param phases_before Phase totals taken before the input was parsed
+ * @return Exit status of the timed command
+ */
+int time_command(const ParsedInput *parsed_command, const double phases_before[TIMING_PHASE_COUNT]);
+
+/**
+ * @brief Read-Eval-Print Loop (REPL) for the shell
+ *
+ * @return Exit code passed to the exit command
+ */
+int read_eval_print_loop();
 
 // ============================================================================
 //
@@ -64,46 +131,38 @@ void print_prompt(const int last_result);
 // Definitions
 // ============================================================================
 
-ParsedInput parse_arguments(const char *command)
+int process_input(const char *input_line, bool in_tail_position)
 {
-    ParsedInput result;
-    result.count = 0;
-    result.arguments = NULL;
+    double phases_before[TIMING_PHASE_COUNT];
+    timing_phase_snapshot(phases_before);
 
-    char *copy = strdup(command); // make a mutable copy
-    if (!copy)
+    // A loop streams the words it goes through, they are never all parsed
+    if (loop_is_for(input_line))
     {
-        return result;
+        return loop_run_for(input_line, run_loop_command);
     }
 
-    uint capacity = 8;
-    result.arguments = malloc(sizeof(char *) * capacity);
-    int argument_count = 0;
+    // Process input (command + arguments)
+    double parse_start = timing_now();
+    trace_begin("parse_arguments");
+    ParsedInput parsed_command = parse_arguments(input_line);
 
-    char *argument = strtok(copy, " ");
-    while (argument != NULL)
+    // Brace expansion, only when the words have braces
+    if (expand_needed(&parsed_command))
     {
-        if (argument_count >= capacity)
+        ParsedInput expanded_command;
+        bool expanded = expand_arguments(&parsed_command, &expanded_command);
+        parsed_input_destroy(&parsed_command);
+
+        if (!expanded)
         {
-            capacity *= 2;
-            result.arguments = realloc(result.arguments, sizeof(char *) * capacity);
+            trace_end("parse_arguments");
+            return EXIT_FAILURE;
         }
-        result.arguments[argument_count++] = strdup(argument); // copy the argument
-        argument = strtok(NULL, " ");
+        parsed_command = expanded_command;
     }
-
-    // NULL-terminate the array
-    result.arguments[argument_count] = NULL;
-    result.count = argument_count;
-
-    free(copy); // we don't need the original copy anymore
-    return result;
-}
-
-int process_input(const char *input_line)
-{
-    // Process input (command + arguments)
-    ParsedInput parsed_command = parse_arguments(input_line);
+    trace_end("parse_arguments");
+    timing_phase_add(TIMING_PHASE_PARSE, timing_now() - parse_start);
 
     // The command is the first word in the whole input
     const char *command_name = parsed_command.arguments[0];
@@ -131,33 +190,169 @@ int process_input(const char *input_line)
 
     // Pressing enter without writing anything will call this function twice
     // one time with an empty string and one time with NULL.
+    int exit_status = 0;
+
     if (command_name == NULL)
     {
-        return builtin_execute_empty();
+        exit_status = builtin_execute_empty();
+    }
+    else if (!strcmp(command_name, "time"))
+    {
+        // `time` is a reserved word and not a builtin: it has to wrap the
+        // whole execution of the command that follows it.
+        exit_status = time_command(&parsed_command, phases_before);
     }
+    else if (in_tail_position && can_exec_in_place(&parsed_command))
+    {
+        // Only returns if the exec failed
+        exit_status = exec_process(&parsed_command);
+    }
+    else
+    {
+        exit_status = execute_command(&parsed_command, NULL);
+    }
+
+    parsed_input_destroy(&parsed_command);
 
+    return exit_status;
+}
+
+CommandResult run_loop_command(const char *command)
+{
+    return process_input(command, false);
+}
+
+bool can_exec_in_place(const ParsedInput *parsed_command)
+{
+    // Builtins have to run inside the shell, and pipelines need it to wait for
+    // all their stages. The shell has no traps or background jobs yet, so the
+    // only later work that an exec would skip is writing the trace, which
+    // needs the end of the child's lifetime, and reaping the coprocesses.
+    return pipeline_count_stages(parsed_command) == 1 && !builtin_exists(parsed_command->arguments[0]) &&
+           !trace_enabled() && !coproc_any_running();
+}
+
+void usage_since(const struct rusage *self_before, const struct rusage *children_before, struct rusage *usage)
+{
+    struct rusage children;
+    getrusage(RUSAGE_SELF, usage);
+    getrusage(RUSAGE_CHILDREN, &children);
+
+    timersub(&usage->ru_utime, &self_before->ru_utime, &usage->ru_utime);
+    timersub(&usage->ru_stime, &self_before->ru_stime, &usage->ru_stime);
+    timersub(&children.ru_utime, &children_before->ru_utime, &children.ru_utime);
+    timersub(&children.ru_stime, &children_before->ru_stime, &children.ru_stime);
+    timeradd(&usage->ru_utime, &children.ru_utime, &usage->ru_utime);
+    timeradd(&usage->ru_stime, &children.ru_stime, &usage->ru_stime);
+
+    usage->ru_nvcsw += children.ru_nvcsw - children_before->ru_nvcsw - self_before->ru_nvcsw;
+    usage->ru_nivcsw += children.ru_nivcsw - children_before->ru_nivcsw - self_before->ru_nivcsw;
+    if (children.ru_maxrss > children_before->ru_maxrss && children.ru_maxrss > usage->ru_maxrss)
+    {
+        usage->ru_maxrss = children.ru_maxrss;
+    }
+}
+
+int execute_command(const ParsedInput *parsed_command, struct rusage *usage)
+{
     int exit_status = 0;
 
-    if (builtin_exists(command_name))
+    double lookup_start = timing_now();
+    bool is_pipeline = pipeline_count_stages(parsed_command) > 1;
+    bool is_builtin = !is_pipeline && builtin_exists(parsed_command->arguments[0]);
+    timing_phase_add(TIMING_PHASE_LOOKUP, timing_now() - lookup_start);
+
+    if (is_builtin || is_pipeline)
     {
-        exit_status = builtin_execute(&parsed_command, NULL, 0);
+        // Builtins run inside the shell process (so do the builtin stages of
+        // a pipeline, on threads), so their usage is the difference of the
+        // shell's own usage before and after running them, plus whatever the
+        // children they launched (timeout, cache, other stages...) used.
+        struct rusage self_before;
+        struct rusage children_before;
+        getrusage(RUSAGE_SELF, &self_before);
+        getrusage(RUSAGE_CHILDREN, &children_before);
+
+        if (is_pipeline)
+        {
+            exit_status = pipeline_run(parsed_command);
+        }
+        else
+        {
+            CommandIO io;
+            io_init(&io, STDIN_FILENO, STDOUT_FILENO);
+
+            double builtin_start = timing_now();
+            trace_begin(parsed_command->arguments[0]);
+            exit_status = builtin_execute(parsed_command, &io);
+            trace_end(parsed_command->arguments[0]);
+            timing_phase_add(TIMING_PHASE_BUILTIN, timing_now() - builtin_start);
+        }
+
+        if (usage != NULL)
+        {
+            usage_since(&self_before, &children_before, usage);
+        }
     }
     else
     {
-        exit_status = launch_process(&parsed_command, NULL, 0);
+        exit_status = launch_process_with_usage(parsed_command, usage);
     }
 
     return exit_status;
 }
 
-void print_prompt(const int last_result)
+int time_command(const ParsedInput *parsed_command, const double phases_before[TIMING_PHASE_COUNT])
 {
-    printf("%s", DEFAULT_PROMPT_OPENING);
-    if (last_result != 0)
+    bool verbose = false;
+    uint first_word = 1; // Skip the `time` word itself
+
+    if (first_word < parsed_command->count && !strcmp(parsed_command->arguments[first_word], "-v"))
     {
-        printf("[%i]", last_result);
+        verbose = true;
+        first_word++;
     }
-    printf("%s", DEFAULT_PROMPT_CLOSING);
+
+    // A view over the remaining words, no need to copy them
+    ParsedInput timed_command = {
+        .count = parsed_command->count - first_word,
+        .arguments = parsed_command->arguments + first_word,
+    };
+
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    int exit_status = 0;
+
+    double real_start = timing_now();
+    if (timed_command.count > 0)
+    {
+        exit_status = execute_command(&timed_command, &usage);
+    }
+    double real = timing_now() - real_start;
+
+    fprintf(stderr, "real    %.6fs\n", real);
+    fprintf(stderr, "user    %ld.%06lds\n", (long)usage.ru_utime.tv_sec, (long)usage.ru_utime.tv_usec);
+    fprintf(stderr, "sys     %ld.%06lds\n", (long)usage.ru_stime.tv_sec, (long)usage.ru_stime.tv_usec);
+    // The kernel only keeps the peak RSS of a whole process, so for commands
+    // that run inside the shell it is the shell's peak over its whole life
+    bool in_process = timed_command.count > 0 && (pipeline_count_stages(&timed_command) > 1 ||
+                                                   builtin_exists(timed_command.arguments[0]));
+    fprintf(stderr, "maxrss  %ld KiB%s\n", usage.ru_maxrss, in_process ? " (peak of the shell, ran in-process)" : "");
+    fprintf(stderr, "ctxsw   %ld voluntary, %ld involuntary\n", usage.ru_nvcsw, usage.ru_nivcsw);
+
+    if (verbose)
+    {
+        double phases_after[TIMING_PHASE_COUNT];
+        timing_phase_snapshot(phases_after);
+
+        fprintf(stderr, "phases:\n");
+        for (int phase = 0; phase < TIMING_PHASE_COUNT; phase++)
+        {
+            fprintf(stderr, "  %-8s %.6fs\n", timing_phase_name(phase), phases_after[phase] - phases_before[phase]);
+        }
+    }
+
+    return exit_status;
 }
 
 char *read_line(void)
@@ -166,6 +361,9 @@ char *read_line(void)
     size_t bufsize = 0; // getline will allocate a buffer for us
     if (getline(&line, &bufsize, stdin) == -1)
     {
+        // The shell exits from here, the trace is written by the exit
+        // handlers and needs the end of the event the REPL began
+        trace_end("read_line");
         if (feof(stdin))
         {
             exit(EXIT_SUCCESS); // We received an EOF (Ctrl+D)
@@ -185,6 +383,8 @@ char *read_line(void)
 
 void sigint_handler(int sig)
 {
+    // Ctrl+C also stops a running for loop, not just its current command
+    loop_interrupt();
     printf("\n");
     print_prompt(0);
     fflush(stdout);
@@ -197,10 +397,78 @@ int read_eval_print_loop()
     while (true)
     {
         print_prompt(last_result);
+        // The prompt has no newline, make sure it is shown even when stdout
+        // is not a terminal (and thus not line buffered)
+        fflush(stdout);
+
+        trace_begin("read_line");
+        char *line = read_line();
+        trace_end("read_line");
+
+        last_result = process_input(line, false);
+        free(line);
+
+        // Keep the trace ring buffer from overwriting unflushed events
+        trace_flush_if_needed();
+    }
+
+    return last_result;
+}
+
+/**
+ * @brief Check whether a script line has a command in it (it is neither blank
+ *  nor a comment)
+ *
+ * @param line Line to check
+ * @return true if the line has to be executed
+ */
+static bool line_has_command(const char *line)
+{
+    const char *first = line + strspn(line, " \t");
+    return *first != '\0' && *first != '#';
+}
 
-        const char *line = read_line();
+/**
+ * @brief Read the next line of a script that has a command in it
+ *
+ * @param script Stream the lines are read from
+ * @return The line (without its \n), or NULL at the end of the script. Must
+ *  be freed by the caller.
+ */
+static char *read_script_line(FILE *script)
+{
+    char *line = NULL;
+    size_t bufsize = 0;
 
-        last_result = process_input(line);
+    while (getline(&line, &bufsize, script) != -1)
+    {
+        line[strcspn(line, "\n")] = 0;
+        if (line_has_command(line))
+        {
+            return line;
+        }
+    }
+
+    free(line);
+    return NULL;
+}
+
+int run_script(FILE *script)
+{
+    int last_result = 0;
+
+    // One line of lookahead, to know whether the current one is the last
+    char *line = read_script_line(script);
+
+    while (line != NULL)
+    {
+        char *next_line = read_script_line(script);
+
+        last_result = process_input(line, next_line == NULL);
+        free(line);
+
+        trace_flush_if_needed();
+        line = next_line;
     }
 
     return last_result;
@@ -208,6 +476,44 @@ int read_eval_print_loop()
 
 int main(int argc, char *argv[])
 {
+    // A builtin writing to a pipe whose reader is gone (`help | head -1`) gets
+    // EPIPE instead of killing the whole shell. Children restore the default.
+    signal(SIGPIPE, SIG_IGN);
+
+    // Opt-in tracing of the shell internals, see trace.h
+    trace_start_from_env();
+
+    // josh -c "command": run the given string as a script
+    if (argc >= 3 && !strcmp(argv[1], "-c"))
+    {
+        FILE *script = fmemopen(argv[2], strlen(argv[2]), "r");
+        if (script == NULL)
+        {
+            perror("myshell: -c");
+            return EXIT_FAILURE;
+        }
+
+        int exit_code = run_script(script);
+        fclose(script);
+        return exit_code;
+    }
+
+    // josh FILE: run the lines of the file
+    if (argc >= 2)
+    {
+        // "e" (O_CLOEXEC): the commands it runs must not inherit the script
+        FILE *script = fopen(argv[1], "re");
+        if (script == NULL)
+        {
+            perror("myshell");
+            return 127;
+        }
+
+        int exit_code = run_script(script);
+        fclose(script);
+        return exit_code;
+    }
+
     // Signal handlers (to capture Ctrl+C and the likes)
     signal(SIGINT, sigint_handler);
 
@@ -0,0 +1,77 @@
+#include "parser.h"
+#include <stdlib.h> // For malloc, realloc, free
+#include <string.h> // For strdup, strlen, strtok_r
+
+ParsedInput parse_arguments(const char *command)
+{
+    ParsedInput result;
+    result.count = 0;
+    result.arguments = NULL;
+
+    // Make a mutable copy with spaces around every '|', so that the pipes are
+    // words of their own even when written without spaces (`ls|wc`)
+    char *copy = malloc(strlen(command) * 3 + 1);
+    if (!copy)
+    {
+        return result;
+    }
+
+    char *end = copy;
+    for (const char *character = command; *character != '\0'; character++)
+    {
+        if (*character == '|')
+        {
+            *end++ = ' ';
+            *end++ = '|';
+            *end++ = ' ';
+        }
+        else
+        {
+            *end++ = *character;
+        }
+    }
+    *end = '\0';
+
+    uint capacity = 8;
+    result.arguments = malloc(sizeof(char *) * capacity);
+    uint argument_count = 0;
+
+    // strtok_r instead of strtok, the tokenizer must not keep hidden state
+    char *save_pointer = NULL;
+    char *argument = strtok_r(copy, " ", &save_pointer);
+    while (argument != NULL)
+    {
+        // + 1 to always leave room for the NULL terminator
+        if (argument_count + 1 >= capacity)
+        {
+            capacity *= 2;
+            result.arguments = realloc(result.arguments, sizeof(char *) * capacity);
+        }
+        result.arguments[argument_count++] = strdup(argument); // copy the argument
+        argument = strtok_r(NULL, " ", &save_pointer);
+    }
+
+    // NULL-terminate the array
+    result.arguments[argument_count] = NULL;
+    result.count = argument_count;
+
+    free(copy); // we don't need the original copy anymore
+    return result;
+}
+
+void parsed_input_destroy(ParsedInput *parsed_input)
+{
+    if (parsed_input == NULL || parsed_input->arguments == NULL)
+    {
+        return;
+    }
+
+    for (uint i = 0; i < parsed_input->count; i++)
+    {
+        free(parsed_input->arguments[i]);
+    }
+    free(parsed_input->arguments);
+
+    parsed_input->arguments = NULL;
+    parsed_input->count = 0;
+}
@@ -0,0 +1,24 @@
+#ifndef MYSHELL_PARSER_H
+#define MYSHELL_PARSER_H
+
+#include "command.h" // For ParsedInput
+
+/**
+ * @brief Splits an input line into its words (command + arguments). Every
+ *  '|' is a word of its own, whether or not it is surrounded by spaces.
+ *
+ * @param command Line to tokenize, it is not modified.
+ * @return A ParsedInput whose arguments array is NULL-terminated. Every string
+ *         in it is heap allocated, release them with parsed_input_destroy.
+ */
+ParsedInput parse_arguments(const char *command);
+
+/**
+ * @brief Frees all memory owned by a ParsedInput returned by parse_arguments.
+ *
+ * @param parsed_input A pointer to the ParsedInput to release. Its fields are
+ *                     reset so it is safe to destroy it twice.
+ */
+void parsed_input_destroy(ParsedInput *parsed_input);
+
+#endif // !MYSHELL_PARSER_H
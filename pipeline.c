@@ -0,0 +1,318 @@
+#define _GNU_SOURCE // For pipe2, must come before any #include
+
+#include "pipeline.h"
+#include "builtins.h" // For builtin_exists, builtin_mutates_state, builtin_execute
+#include "io.h"       // For io_init
+#include "process.h"  // For spawn_process, wait_process
+#include "timing.h"   // For timing_now, timing_phase_add
+#include "trace.h"    // For trace_begin, trace_end, trace_child_begin
+#include <fcntl.h>    // For O_CLOEXEC
+#include <pthread.h>  // For pthread_create, pthread_join
+#include <stdbool.h>  // For bool
+#include <stdio.h>    // For perror, fprintf
+#include <stdlib.h>   // For calloc, free, _exit
+#include <string.h>   // For strcmp, memcpy
+#include <unistd.h>   // For pipe2, fork, close
+
+// Name of the word that separates the stages of a pipeline
+static const char *PIPELINE_SEPARATOR = "|";
+
+// Exit status of a pipeline with an empty stage (same as bash's syntax errors)
+static const int PIPELINE_SYNTAX_ERROR_STATUS = 2;
+
+// How a stage is run
+typedef enum
+{
+    STAGE_NOT_STARTED, // It could not be started, its result is the failure
+    STAGE_PROCESS,     // An external command or a forked builtin, see pid
+    STAGE_THREAD,      // A builtin running on a thread of the shell
+} StageKind;
+
+typedef struct
+{
+    ParsedInput command; // View over the words of the stage
+    StageKind kind;
+    pid_t pid;
+    pthread_t thread;
+    CommandResult result;
+    CommandIO io; // Streams of the stage, the pipes around it
+} PipelineStage;
+
+static bool is_separator(const char *word)
+{
+    return !strcmp(word, PIPELINE_SEPARATOR);
+}
+
+/**
+ * @brief Closes the streams of a stage that are pipe ends (the shell's own
+ *  stdin and stdout stay open).
+ */
+static void close_stage_pipes(const PipelineStage *stage)
+{
+    if (stage->io.input_fd != STDIN_FILENO)
+    {
+        close(stage->io.input_fd);
+    }
+    if (stage->io.output_fd != STDOUT_FILENO)
+    {
+        close(stage->io.output_fd);
+    }
+}
+
+static void *run_builtin_stage(void *argument)
+{
+    PipelineStage *stage = argument;
+
+    double builtin_start = timing_now();
+    trace_begin(stage->command.arguments[0]);
+    stage->result = builtin_execute(&stage->command, &stage->io);
+    trace_end(stage->command.arguments[0]);
+    timing_phase_add(TIMING_PHASE_BUILTIN, timing_now() - builtin_start);
+
+    // The next stage sees the end of its input once this one is done
+    close_stage_pipes(stage);
+
+    return NULL;
+}
+
+/**
+ * @brief Runs a builtin stage in a forked copy of the shell, for the builtins
+ *  that would otherwise change the state of the shell itself. Called before
+ *  any other stage is started, so no thread of the shell is running during
+ *  the fork and every pipe end of the pipeline is still open.
+ *
+ * @param stages      Every stage of the pipeline.
+ * @param stage_count Number of stages.
+ * @param index       Index of the stage to run.
+ */
+static void fork_builtin_stage(PipelineStage stages[], int stage_count, int index)
+{
+    PipelineStage *stage = &stages[index];
+
+    fflush(stdout);
+    fflush(stderr);
+
+    stage->pid = fork();
+    if (stage->pid == 0)
+    {
+        // Keep only the pipe ends of this stage, or the other stages would
+        // never see the end of their input
+        for (int i = 0; i < stage_count; i++)
+        {
+            if (i != index)
+            {
+                close_stage_pipes(&stages[i]);
+            }
+        }
+
+        // Never exit(): it would flush the stdio buffers shared with the
+        // shell, rewinding the script it is reading (see
+        // builtin_enter_subshell). builtin_execute flushes the output.
+        builtin_enter_subshell();
+        CommandResult result = builtin_execute(&stage->command, &stage->io);
+        _exit(result & 0xff);
+    }
+    else if (stage->pid < 0)
+    {
+        perror("myshell");
+        stage->result = -1;
+    }
+    else
+    {
+        stage->kind = STAGE_PROCESS;
+        trace_child_begin(stage->pid, stage->command.arguments[0]);
+    }
+
+    // The child has its own copy of the pipe ends
+    close_stage_pipes(stage);
+}
+
+/**
+ * @brief Starts an external command stage in a child process.
+ */
+static void start_process_stage(PipelineStage *stage)
+{
+    LaunchOptions options = launch_options_default();
+    options.stdin_fd = stage->io.input_fd;
+    options.stdout_fd = stage->io.output_fd;
+
+    stage->pid = spawn_process(&stage->command, &options);
+    if (stage->pid < 0)
+    {
+        stage->result = -1;
+    }
+    else
+    {
+        stage->kind = STAGE_PROCESS;
+    }
+
+    // The child has its own copy of the pipe ends
+    close_stage_pipes(stage);
+}
+
+/**
+ * @brief Starts a builtin stage that doesn't mutate the shell on a thread of
+ *  the shell.
+ */
+static void start_thread_stage(PipelineStage *stage)
+{
+    if (pthread_create(&stage->thread, NULL, run_builtin_stage, stage) == 0)
+    {
+        // The thread owns the pipe ends of the stage from now on
+        stage->kind = STAGE_THREAD;
+        return;
+    }
+
+    // Forking it instead is not an option, other threads already run. Its
+    // neighbours see a closed pipe, as if it exited right away.
+    fprintf(stderr, "myshell: %s: could not start a thread\n", stage->command.arguments[0]);
+    stage->result = -1;
+    close_stage_pipes(stage);
+}
+
+// =================================================================
+// Public functions
+// =================================================================
+
+int pipeline_count_stages(const ParsedInput *parsed_input)
+{
+    if (parsed_input->count == 0)
+    {
+        return 0;
+    }
+
+    int stage_count = 1;
+    for (uint i = 0; i < parsed_input->count; i++)
+    {
+        if (is_separator(parsed_input->arguments[i]))
+        {
+            stage_count++;
+        }
+    }
+
+    return stage_count;
+}
+
+CommandResult pipeline_run(const ParsedInput *parsed_input)
+{
+    int stage_count = pipeline_count_stages(parsed_input);
+
+    // A copy of the array of words (not of the words themselves) where every
+    // separator becomes the NULL that ends the arguments of a stage
+    char **words = malloc(sizeof(char *) * (parsed_input->count + 1));
+    PipelineStage *stages = calloc(stage_count, sizeof(PipelineStage));
+    if (words == NULL || stages == NULL)
+    {
+        perror("myshell");
+        free(words);
+        free(stages);
+        return -1;
+    }
+    memcpy(words, parsed_input->arguments, sizeof(char *) * (parsed_input->count + 1));
+
+    int stage = 0;
+    uint stage_start = 0;
+    for (uint i = 0; i <= parsed_input->count; i++)
+    {
+        if (i == parsed_input->count || is_separator(words[i]))
+        {
+            words[i] = NULL;
+            stages[stage].command.arguments = words + stage_start;
+            stages[stage].command.count = i - stage_start;
+            stage++;
+            stage_start = i + 1;
+        }
+    }
+
+    for (int i = 0; i < stage_count; i++)
+    {
+        if (stages[i].command.count == 0)
+        {
+            fprintf(stderr, "myshell: syntax error near unexpected token `%s'\n", PIPELINE_SEPARATOR);
+            free(words);
+            free(stages);
+            return PIPELINE_SYNTAX_ERROR_STATUS;
+        }
+    }
+
+    trace_begin("pipeline");
+
+    // One pipe between every two stages. O_CLOEXEC so that no command gets
+    // the pipe ends of the others: only the ones dup'ed to its stdin/stdout
+    // survive the exec.
+    int input_fd = STDIN_FILENO;
+    bool pipes_created = true;
+    for (int i = 0; i < stage_count; i++)
+    {
+        int pipe_fds[2] = {-1, STDOUT_FILENO};
+        if (i < stage_count - 1 && pipes_created && pipe2(pipe_fds, O_CLOEXEC) == -1)
+        {
+            perror("myshell: pipe");
+            pipes_created = false;
+        }
+
+        io_init(&stages[i].io, input_fd, pipe_fds[1]);
+        input_fd = pipe_fds[0];
+    }
+
+    if (!pipes_created)
+    {
+        for (int i = 0; i < stage_count; i++)
+        {
+            close_stage_pipes(&stages[i]);
+        }
+        trace_end("pipeline");
+        free(words);
+        free(stages);
+        return -1;
+    }
+
+    // Every fork before the first thread: forking while threads of the shell
+    // run could copy a lock (of stdio, malloc...) held by one of them, which
+    // the child would wait for forever (its perror when the exec fails, for
+    // one). The forked copies of the shell go first of all, as they close
+    // pipe ends the other children must close as well.
+    for (int i = 0; i < stage_count; i++)
+    {
+        if (builtin_mutates_state(stages[i].command.arguments[0]))
+        {
+            fork_builtin_stage(stages, stage_count, i);
+        }
+    }
+    for (int i = 0; i < stage_count; i++)
+    {
+        if (!builtin_exists(stages[i].command.arguments[0]))
+        {
+            start_process_stage(&stages[i]);
+        }
+    }
+    for (int i = 0; i < stage_count; i++)
+    {
+        const char *command_name = stages[i].command.arguments[0];
+        if (builtin_exists(command_name) && !builtin_mutates_state(command_name))
+        {
+            start_thread_stage(&stages[i]);
+        }
+    }
+
+    for (int i = 0; i < stage_count; i++)
+    {
+        if (stages[i].kind == STAGE_THREAD)
+        {
+            pthread_join(stages[i].thread, NULL);
+        }
+        else if (stages[i].kind == STAGE_PROCESS)
+        {
+            stages[i].result = wait_process(&stages[i].command, stages[i].pid, NULL, NULL);
+        }
+    }
+
+    trace_end("pipeline");
+
+    CommandResult result = stages[stage_count - 1].result;
+
+    free(words);
+    free(stages);
+
+    return result;
+}
@@ -0,0 +1,35 @@
+#ifndef MYSHELL_PIPELINE_H
+#define MYSHELL_PIPELINE_H
+
+#include "command.h" // For ParsedInput, CommandResult
+
+// Pipelines: commands separated by '|' words, each one reading what the
+// previous one writes. All the stages run at the same time, connected by
+// pipes, and the output streams through them as it is produced.
+//
+// External commands are forked as usual. Builtins that don't change the state
+// of the shell (see builtin_mutates_state) run on a thread of the shell with
+// their own CommandIO, reading the pipe before them (`seq 10 | cowrite calc
+// -`) and writing the one after them, which saves a fork per builtin stage. The rest (cd,
+// exit, exec...) run in a forked copy of the shell, like in other shells, so
+// `cd /tmp | cat` leaves the working directory of the shell alone.
+
+/**
+ * @brief Counts the stages of a command line.
+ *
+ * @param parsed_input Words of the command line.
+ * @return Number of stages (1 for a plain command, 0 for an empty line).
+ */
+int pipeline_count_stages(const ParsedInput *parsed_input);
+
+/**
+ * @brief Runs a pipeline and waits for all its stages to finish.
+ *
+ * @param parsed_input Words of the command line, with "|" words between the
+ *                     stages.
+ * @return Exit status of the last stage, 2 if a stage is empty (`ls | | wc`),
+ *         or a failure code if the pipeline could not be set up.
+ */
+CommandResult pipeline_run(const ParsedInput *parsed_input);
+
+#endif // !MYSHELL_PIPELINE_H
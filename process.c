@@ -1,46 +1,394 @@
+#define _GNU_SOURCE // For pipe2, must come before any #include
+
 #include "process.h"
+#include "timing.h" // For timing_now, timing_phase_add
+#include "trace.h"  // For trace_begin, trace_end, trace_child_begin
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+// How often the child is polled when pidfds are not available (pre 5.3 kernels)
+static const long WAIT_POLL_INTERVAL_NS = 5 * 1000 * 1000;
+
 CommandResult launch_process(const ParsedInput *parsed_input, char *output_buffer, size_t buffer_size)
 {
-    pid_t pid;
-    int status;
+    return launch_process_with_usage(parsed_input, NULL);
+}
+
+CommandResult launch_process_with_usage(const ParsedInput *parsed_input, struct rusage *usage)
+{
+    return launch_process_with_options(parsed_input, NULL, usage);
+}
+
+LaunchOptions launch_options_default(void)
+{
+    LaunchOptions options = {
+        .stdin_fd = -1,
+        .stdout_fd = -1,
+        .stderr_fd = -1,
+        .timeout_seconds = 0,
+        .timeout_signal = SIGTERM,
+        .kill_after_seconds = 0,
+        .limit_count = 0,
+        .wait_for_exec = false,
+    };
+
+    return options;
+}
+
+/**
+ * @brief Makes `fd` the given standard stream of the current process. Meant to
+ *  be called in the child, between fork and exec.
+ */
+static void redirect_standard_stream(int fd, int standard_fd)
+{
+    if (fd < 0 || fd == standard_fd)
+    {
+        return;
+    }
+
+    if (dup2(fd, standard_fd) == -1)
+    {
+        perror("myshell: dup2");
+        _exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Applies the resource limits of the options to the current process.
+ *  Meant to be called in the child, between fork and exec.
+ */
+static void apply_limits(const LaunchOptions *options)
+{
+    for (int i = 0; i < options->limit_count; i++)
+    {
+        struct rlimit limit = {
+            .rlim_cur = options->limits[i].value,
+            .rlim_max = options->limits[i].value,
+        };
+
+        // Going over the soft CPU limit sends SIGXCPU, the hard one SIGKILL.
+        // Leave a second between them so the program can exit gracefully.
+        if (options->limits[i].resource == RLIMIT_CPU && limit.rlim_max != RLIM_INFINITY)
+        {
+            limit.rlim_max++;
+        }
+
+        if (setrlimit(options->limits[i].resource, &limit) == -1)
+        {
+            perror("myshell: setrlimit");
+            _exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * @brief Whether a timed child takes the terminal from the shell: its own
+ *  process group would otherwise be stopped (SIGTTIN) when reading from it.
+ *  Only when the child reads the shell's stdin and the shell is in the
+ *  foreground.
+ */
+static bool takes_terminal(const LaunchOptions *options)
+{
+    return options->timeout_seconds > 0 && (options->stdin_fd < 0 || options->stdin_fd == STDIN_FILENO) &&
+           isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
+}
+
+/**
+ * @brief Makes `group` the foreground process group of the terminal.
+ *  SIGTTOU is blocked meanwhile, as a background group is allowed to do it
+ *  only then.
+ */
+static void give_terminal(pid_t group)
+{
+    sigset_t ttou;
+    sigset_t previous;
+    sigemptyset(&ttou);
+    sigaddset(&ttou, SIGTTOU);
+
+    pthread_sigmask(SIG_BLOCK, &ttou, &previous);
+    tcsetpgrp(STDIN_FILENO, group);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+}
+
+/**
+ * @brief Waits up to `seconds` for the child to terminate, without reaping it.
+ *
+ * @param pid     Pid of the child.
+ * @param pidfd   pidfd of the child, or -1 if not available.
+ * @param seconds Maximum time to wait.
+ * @return true if the child terminated, false if the time ran out.
+ */
+static bool wait_for_exit(pid_t pid, int pidfd, double seconds)
+{
+    if (pidfd != -1)
+    {
+        // A pidfd becomes readable when the process terminates
+        struct pollfd poll_fd = {.fd = pidfd, .events = POLLIN};
+        double deadline = timing_now() + seconds;
+
+        while (true)
+        {
+            // poll takes an int of milliseconds (about 24.8 days at most), so
+            // longer timeouts are waited for in several slices
+            double remaining_ms = (deadline - timing_now()) * 1000;
+            int slice_ms = 0;
+            if (remaining_ms >= INT_MAX - 1)
+            {
+                slice_ms = INT_MAX;
+            }
+            else if (remaining_ms > 0)
+            {
+                slice_ms = (int)(remaining_ms + 0.999);
+            }
+
+            int ready = poll(&poll_fd, 1, slice_ms);
+            if (ready > 0)
+            {
+                return true;
+            }
+            if ((ready == -1 && errno != EINTR) || (ready == 0 && timing_now() >= deadline))
+            {
+                return false;
+            }
+        }
+    }
+
+    // Fallback: check the child every few milliseconds. WNOWAIT leaves it
+    // unreaped so that wait4 can still collect its resource usage.
+    double deadline = timing_now() + seconds;
+    struct timespec interval = {.tv_sec = 0, .tv_nsec = WAIT_POLL_INTERVAL_NS};
+    siginfo_t info;
+
+    while (true)
+    {
+        info.si_pid = 0;
+        if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid)
+        {
+            return true;
+        }
+        if (timing_now() >= deadline)
+        {
+            return false;
+        }
+        nanosleep(&interval, NULL);
+    }
+}
+
+/**
+ * @brief Enforces the timeout of the options on a running child: sends the
+ *  timeout signal when it expires, then SIGKILL if the child is still alive
+ *  kill_after_seconds later. The signals go to the process group of the
+ *  child (see spawn_process), so that its own children stop as well. Returns once the child has terminated (or right
+ *  away if there is no timeout), leaving it unreaped.
+ *
+ * @return 0 if the child exited on time, LAUNCH_TIMEOUT_STATUS or
+ *         LAUNCH_TIMEOUT_KILLED_STATUS otherwise.
+ */
+static int enforce_timeout(pid_t pid, const LaunchOptions *options)
+{
+    if (options->timeout_seconds <= 0)
+    {
+        return 0;
+    }
+
+    int pidfd = -1;
+#ifdef SYS_pidfd_open
+    pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+#endif
+
+    int timeout_status = 0;
+
+    if (!wait_for_exit(pid, pidfd, options->timeout_seconds))
+    {
+        timeout_status = LAUNCH_TIMEOUT_STATUS;
+        kill(-pid, options->timeout_signal);
+
+        if (options->kill_after_seconds > 0 && !wait_for_exit(pid, pidfd, options->kill_after_seconds))
+        {
+            timeout_status = LAUNCH_TIMEOUT_KILLED_STATUS;
+            kill(-pid, SIGKILL);
+        }
+    }
 
-    pid = fork();
+    if (pidfd != -1)
+    {
+        close(pidfd);
+    }
+
+    return timeout_status;
+}
+
+pid_t spawn_process(const ParsedInput *parsed_input, const LaunchOptions *options)
+{
+    LaunchOptions child_options = options != NULL ? *options : launch_options_default();
+
+    // Whatever the shell printed so far must come out before the output of
+    // the child
+    fflush(stdout);
+    fflush(stderr);
+
+    // The child reports a failed exec through this pipe. Being closed on
+    // exec, it reads as empty once the exec has worked.
+    int exec_status[2] = {-1, -1};
+    if (child_options.wait_for_exec && pipe2(exec_status, O_CLOEXEC) == -1)
+    {
+        perror("myshell");
+        return -1;
+    }
+
+    bool timed = child_options.timeout_seconds > 0;
+    bool terminal = takes_terminal(&child_options);
+
+    double spawn_start = timing_now();
+
+    trace_begin("fork");
+    pid_t pid = fork();
     if (pid == 0)
     {
         // --- This is the child process ---
+        if (exec_status[0] != -1)
+        {
+            close(exec_status[0]);
+        }
+        // A timed command gets a process group of its own, which the timeout
+        // signals as a whole (as coreutils' timeout does)
+        if (timed)
+        {
+            setpgid(0, 0);
+            if (terminal)
+            {
+                give_terminal(getpid());
+            }
+        }
+        // The shell ignores SIGPIPE (see main), but a command writing to a
+        // pipe nobody reads anymore must die of it as usual
+        signal(SIGPIPE, SIG_DFL);
+        redirect_standard_stream(child_options.stdin_fd, STDIN_FILENO);
+        redirect_standard_stream(child_options.stdout_fd, STDOUT_FILENO);
+        redirect_standard_stream(child_options.stderr_fd, STDERR_FILENO);
+        apply_limits(&child_options);
+
         // The child process attempts to replace itself with the new program.
         if (execvp(parsed_input->arguments[0], parsed_input->arguments) == -1)
         {
             // execvp only returns if an error occurred.
+            int exec_errno = errno;
             perror("myshell");
-            exit(EXIT_FAILURE); // VERY IMPORTANT: Terminate the child process.
+            if (exec_status[1] != -1)
+            {
+                write(exec_status[1], &exec_errno, sizeof(exec_errno));
+            }
+            // VERY IMPORTANT: Terminate the child process. With _exit, as
+            // exit() would run the atexit handlers of the shell and flush its
+            // stdio streams, moving the shared offset of the script being read
+            _exit(EXIT_FAILURE);
         }
     }
     else if (pid < 0)
     {
         // --- Forking error ---
+        trace_end("fork");
         perror("myshell");
+        if (exec_status[0] != -1)
+        {
+            close(exec_status[0]);
+            close(exec_status[1]);
+        }
         return -1; // Indicate a failure to launch.
     }
 
     // --- This is the parent process ---
-    // The parent waits for the child to terminate.
+    trace_end("fork");
+
+    // Also set here, the group must exist before the timeout may signal it
+    // (whichever of the two runs first)
+    if (timed)
+    {
+        setpgid(pid, pid);
+    }
+
+    if (exec_status[0] != -1)
+    {
+        close(exec_status[1]);
+
+        int exec_errno = 0;
+        ssize_t bytes;
+        while ((bytes = read(exec_status[0], &exec_errno, sizeof(exec_errno))) == -1 && errno == EINTR)
+        {
+        }
+        close(exec_status[0]);
+
+        if (bytes == sizeof(exec_errno))
+        {
+            waitpid(pid, NULL, 0);
+            errno = exec_errno;
+            return -1;
+        }
+    }
+    trace_child_begin(pid, parsed_input->arguments[0]);
+    timing_phase_add(TIMING_PHASE_SPAWN, timing_now() - spawn_start);
+
+    return pid;
+}
 
-    // We pass 0 as the last argument because we are not interested in special
-    // states like WUNTRACED for now. waitpid will block here until the child
-    // has either exited or been killed.
-    if (waitpid(pid, &status, 0) == -1)
+CommandResult wait_process(const ParsedInput *parsed_input, pid_t pid, const LaunchOptions *options,
+                           struct rusage *usage)
+{
+    int status;
+    struct rusage child_usage;
+    LaunchOptions child_options = options != NULL ? *options : launch_options_default();
+
+    double wait_start = timing_now();
+
+    // We pass 0 as the options because we are not interested in special
+    // states like WUNTRACED for now. wait4 will block here until the child
+    // has either exited or been killed. Unlike waitpid, it also fills in the
+    // resources used by the child, which is what `time` reports.
+    trace_begin("wait");
+    int timeout_status = enforce_timeout(pid, &child_options);
+    pid_t waited = wait4(pid, &status, 0, &child_usage);
+
+    // Take the terminal back from the group of a timed child
+    if (child_options.timeout_seconds > 0 && isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == pid)
     {
-        perror("myshell: waitpid failed");
+        give_terminal(getpgrp());
+    }
+    trace_end("wait");
+    trace_child_end(pid, parsed_input->arguments[0]);
+    timing_phase_add(TIMING_PHASE_WAIT, timing_now() - wait_start);
+
+    if (waited == -1)
+    {
+        perror("myshell: wait4 failed");
         return -1; // Return a failure code.
     }
 
+    if (usage != NULL)
+    {
+        *usage = child_usage;
+    }
+
+    // A command stopped by its timeout gets a status of its own, whatever it
+    // did when the signal arrived
+    if (timeout_status != 0)
+    {
+        return timeout_status;
+    }
+
     // Now, we need to check HOW the child terminated.
     if (WIFEXITED(status))
     {
@@ -49,6 +397,40 @@ CommandResult launch_process(const ParsedInput *parsed_input, char *output_buffe
         return WEXITSTATUS(status);
     }
 
-    // If we get here, the child was terminated by a signal.
-    return 1;
+    // If we get here, the child was terminated by a signal. Shells report
+    // it as 128 + the number of the signal.
+    return LAUNCH_SIGNAL_STATUS_BASE + WTERMSIG(status);
+}
+
+CommandResult launch_process_with_options(const ParsedInput *parsed_input, const LaunchOptions *options,
+                                          struct rusage *usage)
+{
+    if (usage != NULL)
+    {
+        memset(usage, 0, sizeof(*usage));
+    }
+
+    pid_t pid = spawn_process(parsed_input, options);
+    if (pid < 0)
+    {
+        return -1; // Indicate a failure to launch.
+    }
+
+    // The parent waits for the child to terminate.
+    return wait_process(parsed_input, pid, options, usage);
+}
+
+CommandResult exec_process(const ParsedInput *parsed_input)
+{
+    // Nothing of the shell runs after a successful exec, its buffers included
+    fflush(stdout);
+    fflush(stderr);
+
+    // Ignored signals stay ignored across exec, undo the shell's SIGPIPE
+    signal(SIGPIPE, SIG_DFL);
+    execvp(parsed_input->arguments[0], parsed_input->arguments);
+
+    // execvp only returns if an error occurred.
+    perror("myshell");
+    return EXIT_FAILURE;
 }
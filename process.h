@@ -1,7 +1,60 @@
 #ifndef MYSHELL_PROCESS_H
 #define MYSHELL_PROCESS_H
 
-#include "command.h" // For ParsedInput, CommandResult
+#include "command.h"      // For ParsedInput, CommandResult
+#include <stdbool.h>
+#include <sys/resource.h> // For struct rusage
+
+// Array sizes must be integer constant expressions in C, so an enum is used
+// here instead of `static const`.
+enum
+{
+    LAUNCH_MAX_LIMITS = 8, // Resource limits that can be set on a child
+};
+
+/**
+ * @brief Exit status of a command killed by a signal is this plus the number
+ *  of the signal (as in other shells).
+ */
+static const int LAUNCH_SIGNAL_STATUS_BASE = 128;
+
+/**
+ * @brief Exit status of a command stopped because it ran out of time and
+ *  terminated after the timeout signal (same as coreutils' timeout).
+ */
+static const int LAUNCH_TIMEOUT_STATUS = 124;
+
+/**
+ * @brief Exit status of a command that ignored the timeout signal and had to
+ *  be killed with SIGKILL (128 + SIGKILL, same as coreutils' timeout).
+ */
+static const int LAUNCH_TIMEOUT_KILLED_STATUS = 137;
+
+/**
+ * @brief A resource limit (setrlimit) applied to the child before exec.
+ */
+typedef struct
+{
+    int resource; // RLIMIT_CPU, RLIMIT_AS, RLIMIT_NOFILE, ...
+    rlim_t value; // Both the soft and the hard limit
+} LaunchLimit;
+
+/**
+ * @brief Optional tweaks applied to the child process before running the
+ *  command. Get one with launch_options_default and change what is needed.
+ */
+typedef struct
+{
+    int stdin_fd;              // File descriptor used as the child's stdin, -1 to inherit
+    int stdout_fd;             // File descriptor used as the child's stdout, -1 to inherit
+    int stderr_fd;             // File descriptor used as the child's stderr, -1 to inherit
+    double timeout_seconds;    // Time before sending timeout_signal, 0 for none
+    int timeout_signal;        // Signal sent when the timeout expires
+    double kill_after_seconds; // Time after timeout_signal before a SIGKILL, 0 for never
+    LaunchLimit limits[LAUNCH_MAX_LIMITS];
+    int limit_count;    // Number of elements used in limits
+    bool wait_for_exec; // Whether spawn_process fails when the exec does (see there)
+} LaunchOptions;
 
 /**
  * @brief Launches an external command in a new child process.
@@ -16,4 +69,94 @@
  */
 CommandResult launch_process(const ParsedInput *parsed_input, char *output_buffer, size_t buffer_size);
 
+/**
+ * @brief Launches an external command and reports the resources it consumed.
+ *
+ * Same as launch_process, but the child is reaped with wait4() so the kernel
+ * hands back its resource usage (CPU times, max RSS, context switches, ...).
+ *
+ * @param parsed_input A pointer to the ParsedInput struct containing the
+ *                     command and its arguments.
+ * @param usage        Where the resource usage of the child is stored. May be
+ *                     NULL if the caller is not interested in it. It is zeroed
+ *                     if the process could not be launched.
+ * @return The exit status of the child process, or a failure code if the
+ *         process could not be launched.
+ */
+CommandResult launch_process_with_usage(const ParsedInput *parsed_input, struct rusage *usage);
+
+/**
+ * @brief Gets the options that make launch_process_with_options behave like
+ *  launch_process (every standard stream inherited from the shell).
+ *
+ * @return A LaunchOptions with the default values.
+ */
+LaunchOptions launch_options_default(void);
+
+/**
+ * @brief Launches an external command with the given options applied to the
+ *  child process, and reports the resources it consumed.
+ *
+ * @param parsed_input A pointer to the ParsedInput struct containing the
+ *                     command and its arguments.
+ * @param options      Options for the child, NULL to use the defaults.
+ * @param usage        Where the resource usage of the child is stored. May be
+ *                     NULL if the caller is not interested in it.
+ * @return The exit status of the child process (see wait_process), or a
+ *         failure code if the process could not be launched.
+ */
+CommandResult launch_process_with_options(const ParsedInput *parsed_input, const LaunchOptions *options,
+                                          struct rusage *usage);
+
+/**
+ * @brief Starts an external command in a new child process, without waiting
+ *  for it. It must be reaped with wait_process.
+ *
+ * A child with a timeout is put in a process group of its own, which the
+ * timeout signals as a whole. It takes the terminal while it runs if it reads
+ * the shell's stdin, wait_process gives it back to the shell.
+ *
+ * By default a child whose exec fails prints the error and exits with status
+ * 1, like a command that failed. With options->wait_for_exec, spawn_process
+ * waits until the exec is done instead (the child reports its failure through
+ * a pipe closed on exec, as posix_spawn does), and fails if it did not work.
+ *
+ * @param parsed_input A pointer to the ParsedInput struct containing the
+ *                     command and its arguments.
+ * @param options      Options for the child, NULL to use the defaults.
+ * @return The pid of the child, or -1 if it could not be created (or, with
+ *         wait_for_exec, could not run the command, errno telling why; the
+ *         child is reaped then).
+ */
+pid_t spawn_process(const ParsedInput *parsed_input, const LaunchOptions *options);
+
+/**
+ * @brief Waits for a child started with spawn_process, enforcing the timeout
+ *  of the options, and reaps it.
+ *
+ * @param parsed_input The command the child runs (for the trace).
+ * @param pid          Pid returned by spawn_process.
+ * @param options      The options the child was spawned with, NULL for the
+ *                     defaults.
+ * @param usage        Where the resource usage of the child is stored. May be
+ *                     NULL if the caller is not interested in it.
+ * @return The exit status of the child process, LAUNCH_SIGNAL_STATUS_BASE +
+ *         the signal if one killed it, LAUNCH_TIMEOUT_STATUS or
+ *         LAUNCH_TIMEOUT_KILLED_STATUS if it was stopped by the timeout, or a
+ *         failure code if it could not be waited for.
+ */
+CommandResult wait_process(const ParsedInput *parsed_input, pid_t pid, const LaunchOptions *options,
+                           struct rusage *usage);
+
+/**
+ * @brief Replaces the shell process with an external command (execvp without
+ *  a fork). Pending stdio output of the shell is flushed first.
+ *
+ * @param parsed_input A pointer to the ParsedInput struct containing the
+ *                     command and its arguments.
+ * @return Only returns if the command could not be executed, with a failure
+ *         code. The shell keeps running in that case.
+ */
+CommandResult exec_process(const ParsedInput *parsed_input);
+
 #endif
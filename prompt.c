@@ -0,0 +1,13 @@
+#include "prompt.h"
+#include "constants.h" // For DEFAULT_PROMPT_OPENING, DEFAULT_PROMPT_CLOSING
+#include <stdio.h>     // For printf
+
+void print_prompt(const int last_result)
+{
+    printf("%s", DEFAULT_PROMPT_OPENING);
+    if (last_result != 0)
+    {
+        printf("[%i]", last_result);
+    }
+    printf("%s", DEFAULT_PROMPT_CLOSING);
+}
@@ -0,0 +1,11 @@
+#ifndef MYSHELL_PROMPT_H
+#define MYSHELL_PROMPT_H
+
+/**
+ * @brief Print the shell prompt
+ *
+ * @param last_result Last result of the last command executed
+ */
+void print_prompt(const int last_result);
+
+#endif // !MYSHELL_PROMPT_H
@@ -0,0 +1,56 @@
+# Helpers of the behaviour tests, sourced by run.sh before each test file.
+#
+# JOSH is the shell under test, SANDBOX a directory of the test file's own
+# (the current directory is SANDBOX/work).
+
+passed=0
+failed=0
+
+pass() {
+    passed=$((passed + 1))
+}
+
+# fail NAME MESSAGE
+fail() {
+    failed=$((failed + 1))
+    echo "FAIL $1: $2"
+}
+
+# expect_equal NAME EXPECTED ACTUAL
+expect_equal() {
+    if [ "$2" = "$3" ]; then
+        pass
+    else
+        fail "$1" "expected [$2], got [$3]"
+    fi
+}
+
+# expect_match NAME PATTERN ACTUAL (PATTERN is a grep -E regular expression)
+expect_match() {
+    if printf '%s\n' "$3" | grep -Eq -- "$2"; then
+        pass
+    else
+        fail "$1" "expected a match for /$2/ in [$3]"
+    fi
+}
+
+# Time after which a shell under test is considered stuck
+JOSH_RUN_TIMEOUT=60
+
+# josh_run LINES...: runs the lines as a script (one command per line), with
+# /dev/null as stdin. Prints what the shell printed, returns its status (124
+# if it got stuck).
+josh_run() {
+    printf '%s\n' "$@" > "$SANDBOX/script.josh"
+    if command -v timeout > /dev/null; then
+        timeout "$JOSH_RUN_TIMEOUT" "$JOSH" "$SANDBOX/script.josh" < /dev/null
+    else
+        "$JOSH" "$SANDBOX/script.josh" < /dev/null
+    fi
+}
+
+# Prints the result of the test file, fails if any check did.
+test_summary() {
+    echo "$passed passed, $failed failed"
+    [ "$failed" -eq 0 ]
+}
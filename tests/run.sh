@@ -0,0 +1,56 @@
+#!/bin/sh
+# Runs the behaviour tests of the shell: every tests/test_*.sh file, each one
+# in a fresh sandbox directory that also holds the cache store, the frecency
+# database and HOME, so the tests never touch the user's own files.
+#
+# Usage: tests/run.sh JOSH [JOSH_BENCH]
+#
+# Exits with the number of test files that had a failure (0 if all passed).
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 JOSH [JOSH_BENCH]" >&2
+    exit 2
+fi
+
+absolute_path() {
+    echo "$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+}
+
+TESTS_DIR=$(cd "$(dirname "$0")" && pwd)
+JOSH=$(absolute_path "$1")
+JOSH_BENCH=
+if [ $# -ge 2 ]; then
+    JOSH_BENCH=$(absolute_path "$2")
+fi
+export TESTS_DIR JOSH JOSH_BENCH
+
+failed_files=0
+for test_file in "$TESTS_DIR"/test_*.sh; do
+    SANDBOX=$(mktemp -d "${TMPDIR:-/tmp}/josh-test.XXXXXX")
+
+    (
+        export SANDBOX
+        export HOME="$SANDBOX/home"
+        export XDG_CACHE_HOME="$SANDBOX/home/.cache"
+        export XDG_DATA_HOME="$SANDBOX/home/.local/share"
+        export JOSH_CACHE_DIR="$SANDBOX/cache"
+        export JOSH_FRECENCY_FILE="$SANDBOX/frecency.db"
+        unset JOSH_CACHE_MAX_BYTES JOSH_TRACE_FILE
+        mkdir -p "$HOME" "$SANDBOX/work"
+        cd "$SANDBOX/work" || exit 1
+
+        . "$TESTS_DIR/lib.sh"
+        echo "--- $(basename "$test_file")"
+        . "$test_file"
+        test_summary
+    ) || failed_files=$((failed_files + 1))
+
+    rm -rf "$SANDBOX"
+done
+
+if [ "$failed_files" -eq 0 ]; then
+    echo "All tests passed"
+else
+    echo "$failed_files test file(s) had failures"
+fi
+exit "$failed_files"
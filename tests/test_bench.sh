@@ -0,0 +1,30 @@
+# The benchmark harness (bench/bench.c): it runs, reports every metric, and
+# --compare flags the metrics that got worse than a baseline.
+
+if [ -z "$JOSH_BENCH" ]; then
+    echo "skipped: no josh_bench given"
+else
+    "$JOSH_BENCH" --shell "$JOSH" --output "$SANDBOX/run.txt" > /dev/null
+    expect_equal "bench status" 0 $?
+
+    for metric in tokenizer_throughput tokenizer_words brace_expansion_words builtin_dispatch_latency \
+        spawn_true_latency script_builtin_throughput prompt_render_latency startup_to_prompt; do
+        expect_match "bench reports $metric" "^$metric	[0-9.]+	" "$(cat "$SANDBOX/run.txt")"
+    done
+
+    # A baseline where the tokenizer was a thousand times faster
+    awk -F '\t' -v OFS='\t' '$1 == "tokenizer_throughput" { $2 = $2 * 1000 } { print }' "$SANDBOX/run.txt" \
+        > "$SANDBOX/baseline.txt"
+    comparison=$("$JOSH_BENCH" --shell "$JOSH" --output "$SANDBOX/again.txt" --compare "$SANDBOX/baseline.txt" \
+        --threshold 50 2>&1 > /dev/null)
+    status=$?
+    expect_match "compare flags a regression" "^tokenizer_throughput .*REGRESSION" "$comparison"
+    [ "$status" -ne 0 ] && pass || fail "compare status" "expected non-zero with a regression"
+fi
+
+# A baseline that can't be read is an error, not a run without regressions
+if [ -n "$JOSH_BENCH" ]; then
+    comparison=$("$JOSH_BENCH" --shell "$JOSH" --compare "$SANDBOX/missing.txt" 2>&1 > /dev/null)
+    expect_equal "missing baseline status" 2 $?
+    expect_match "missing baseline reported" "missing.txt|No such file" "$comparison"
+fi
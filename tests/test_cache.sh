@@ -0,0 +1,84 @@
+# The cache builtin: what is part of the key, what invalidates an entry, and
+# what is never stored.
+
+# Counts its runs, writes to both streams and exits with 3
+cat > "$SANDBOX/counted.sh" <<'SCRIPT'
+echo run >> "$SANDBOX/runs"
+echo "out $*"
+echo "err $*" >&2
+exit 3
+SCRIPT
+
+runs() {
+    if [ -f "$SANDBOX/runs" ]; then wc -l < "$SANDBOX/runs" | tr -d ' '; else echo 0; fi
+}
+
+counted="cache sh $SANDBOX/counted.sh"
+
+# A hit replays both streams and the status without running the command
+output=$(josh_run "$counted a" "$counted a" 2>&1)
+expect_equal "hit replays the outputs" "out a
+err a
+out a
+err a" "$output"
+josh_run "$counted a" > /dev/null 2>&1
+expect_equal "hit replays the status" 3 $?
+expect_equal "hit does not run the command" 1 "$(runs)"
+
+# The arguments are part of the key
+josh_run "$counted b" > /dev/null 2>&1
+expect_equal "other arguments miss" 2 "$(runs)"
+
+# So is the working directory
+mkdir -p "$SANDBOX/elsewhere"
+josh_run "cd $SANDBOX/elsewhere" "$counted a" > /dev/null 2>&1
+expect_equal "other directory misses" 3 "$(runs)"
+
+# A dependency invalidates the entry when its metadata changes
+echo one > "$SANDBOX/dep"
+touch -d '2001-01-01' "$SANDBOX/dep"
+josh_run "cache --dep $SANDBOX/dep sh $SANDBOX/counted.sh d" "cache --dep $SANDBOX/dep sh $SANDBOX/counted.sh d" \
+    > /dev/null 2>&1
+expect_equal "unchanged dependency hits" 4 "$(runs)"
+touch -d '2002-02-02' "$SANDBOX/dep"
+josh_run "cache --dep $SANDBOX/dep sh $SANDBOX/counted.sh d" > /dev/null 2>&1
+expect_equal "changed dependency misses" 5 "$(runs)"
+
+# The requested environment variables are part of the key
+CACHE_TEST_VALUE=1 josh_run "cache --env CACHE_TEST_VALUE sh $SANDBOX/counted.sh e" > /dev/null 2>&1
+CACHE_TEST_VALUE=1 josh_run "cache --env CACHE_TEST_VALUE sh $SANDBOX/counted.sh e" > /dev/null 2>&1
+expect_equal "same variable hits" 6 "$(runs)"
+CACHE_TEST_VALUE=2 josh_run "cache --env CACHE_TEST_VALUE sh $SANDBOX/counted.sh e" > /dev/null 2>&1
+expect_equal "changed variable misses" 7 "$(runs)"
+
+# An expired entry is run again
+josh_run "cache --ttl 1 sh $SANDBOX/counted.sh t" > /dev/null 2>&1
+sleep 2
+josh_run "cache --ttl 1 sh $SANDBOX/counted.sh t" > /dev/null 2>&1
+expect_equal "expired entry misses" 9 "$(runs)"
+
+# The input is not part of the key, so a piped command always runs
+output=$(josh_run "echo foo | cache tr a-z A-Z" "echo bar | cache tr a-z A-Z")
+expect_equal "piped input is not replayed" "FOO
+BAR" "$output"
+
+# A command killed by a signal is not stored
+entries_before=$(josh_run "cache --stats" | awk '$1 == "entries" { print $2 }')
+josh_run "cache sh -c kill\${IFS}-9\${IFS}\$\$" > /dev/null 2>&1
+expect_equal "signal death status" 137 $?
+entries_after=$(josh_run "cache --stats" | awk '$1 == "entries" { print $2 }')
+expect_equal "signal death is not stored" "$entries_before" "$entries_after"
+
+# A command that can't be executed is never stored: it stays a miss
+output=$(josh_run "cache josh_missing_command" "cache josh_missing_command" 2>&1)
+status=$?
+expect_equal "missing command reports each run" 2 "$(printf '%s\n' "$output" | grep -c "No such file")"
+expect_equal "missing command status" 1 $status
+
+# The statistics add up, and --clear empties the store
+stats=$(josh_run "cache --stats")
+expect_match "hits are counted" "^hits +4$" "$stats"
+expect_match "misses are counted" "^misses +12$" "$stats"
+josh_run "cache --clear" "cache --stats" > "$SANDBOX/stats"
+expect_match "clear removes the entries" "^entries +0$" "$(cat "$SANDBOX/stats")"
+expect_match "clear removes the objects" "^size +0 bytes" "$(cat "$SANDBOX/stats")"
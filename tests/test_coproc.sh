@@ -0,0 +1,58 @@
+# Coprocesses: start, line exchanges, listing, closing, failures, and the
+# reaping of the ones still running when the shell exits.
+
+output=$(josh_run "coproc up sed -u s/a/A/g" "cowrite up banana" "coread up" "cowrite up cat" "coread up" \
+    "coclose up")
+expect_equal "line exchanges" "bAnAnA
+cAt" "$output"
+
+# Requests are buffered until an answer is read, several of them at once
+output=$(josh_run "coproc up sed -u s/a/A/g" "cowrite up a1" "cowrite up a2" "coread up" "coread up" "coclose up")
+expect_equal "buffered requests" "A1
+A2" "$output"
+
+# Answers can go through a pipeline
+expect_equal "coread in a pipeline" "X" "$(josh_run "coproc up sed -u s/x/X/" "cowrite up x" "coread up | cat")"
+
+# Listed while running, gone once closed
+listing=$(josh_run "coproc helper cat" "coproc")
+expect_match "listed" "^helper +pid [0-9]+ .* cat$" "$listing"
+expect_equal "closed" "" "$(josh_run "coproc helper cat" "coclose helper" "coproc")"
+
+# The listed fds are inherited by the commands of the script: a request
+# written to the write fd, and its answer read from the read fd, directly
+fds=$(josh_run "coproc up cat" "coproc" | awk '{ print $6, $9 }')
+write_fd=${fds% *}
+read_fd=${fds#* }
+expect_equal "fds used directly" "bAnAnA" "$(josh_run "coproc up sed -u s/a/A/g" \
+    "sh -c echo\${IFS}banana>&$write_fd;read\${IFS}answer<&$read_fd;echo\${IFS}\$answer")"
+
+# But not by the other coprocesses: the first one still sees the end of its
+# input (cat exits with 0 instead of the SIGTERM of the grace period)
+josh_run "coproc first cat" "coproc second sleep 30" "coclose first"
+expect_equal "fds not inherited by coprocesses" 0 $?
+
+josh_run "coproc helper sh -c exit\${IFS}5" "coclose helper"
+expect_equal "status of the closed coprocess" 5 $?
+
+# Failures
+josh_run "coproc dup cat" "coproc dup cat" 2> /dev/null
+expect_equal "duplicate name" 1 $?
+josh_run "coread nobody" 2> /dev/null
+expect_equal "unknown name" 1 $?
+josh_run "coproc" "coproc missing no_such_command_here" 2> /dev/null
+expect_equal "command that can't be run" 1 $?
+expect_equal "no slot taken by a failed start" "" "$(josh_run "coproc missing no_such_command_here" "coproc" \
+    2> /dev/null)"
+josh_run "cowrite" 2> /dev/null
+expect_equal "usage status" 2 $?
+
+# The shell reaps the coprocesses left running when it exits, even one that
+# ignores the end of its input
+pid=$(josh_run "coproc sleeper sleep 30" "coproc" | awk '{ print $3 }')
+if [ -n "$pid" ] && ! kill -0 "$pid" 2> /dev/null; then
+    pass
+else
+    kill "$pid" 2> /dev/null
+    fail "reaped at exit" "pid [$pid] still running"
+fi
@@ -0,0 +1,60 @@
+# Brace expansion and for loops: the forms of brace expressions, the words
+# that stay as they are, the size limit, and loops streaming large ranges.
+
+expect_brace() {
+    expect_equal "echo $1" "$2" "$(josh_run "echo $1")"
+}
+
+expect_brace "{a,b,c}" "a b c"
+expect_brace "pre{a,b}post" "preapost prebpost"
+expect_brace "x{a,b}{1,2}" "xa1 xa2 xb1 xb2"
+expect_brace "{1..5}" "1 2 3 4 5"
+expect_brace "{5..1}" "5 4 3 2 1"
+expect_brace "{-2..2}" "-2 -1 0 1 2"
+expect_brace "{1..10..3}" "1 4 7 10"
+expect_brace "{1..3..-1}" "1 2 3"
+expect_brace "{08..10}" "08 09 10"
+expect_brace "{a..e}" "a b c d e"
+expect_brace "{a..e..2}" "a c e"
+expect_brace "{a,}" "a "
+expect_brace "{} {a} {1..} {..3}" "{} {a} {1..} {..3}"
+expect_brace "plain" "plain"
+
+# Ranges that don't fit in 64 bits stay as they are
+expect_brace "{-9223372036854775808..9223372036854775807}" "{-9223372036854775808..9223372036854775807}"
+expect_brace "{1..99999999999999999999}" "{1..99999999999999999999}"
+expect_brace "{1..3..-9223372036854775808}" "{1..3..-9223372036854775808}"
+expect_brace "{9223372036854775806..9223372036854775807}" "9223372036854775806 9223372036854775807"
+expect_brace "{-9223372036854775807..9223372036854775807..9223372036854775807}" \
+    "-9223372036854775807 0 9223372036854775807"
+expect_equal "for over a range too large" "x" \
+    "$(josh_run "for i in {-9223372036854775808..9223372036854775807}; do echo x; done")"
+
+# Too many words is an error, not an attempt to allocate them
+output=$(josh_run "echo {1..100000}{1..100000}" 2>&1)
+status=$?
+expect_match "too many words reported" "too many words" "$output"
+[ "$status" -ne 0 ] && pass || fail "too many words status" "expected non-zero"
+
+# for loops
+expect_equal "for loop" "1 1x
+2 2x
+3 3x" "$(josh_run "for i in {1..3}; do echo \$i \${i}x; done")"
+expect_equal "for over several words" "a b c d" "$(josh_run "for w in a {b,c} d; do echo \$w; done" | xargs)"
+expect_equal "other names are left alone" "\$j" "$(josh_run "for i in 1; do echo \$j; done")"
+expect_equal "empty list" "" "$(josh_run "for i in; do echo \$i; done")"
+
+josh_run "for i in 1 2 do echo; done" 2> /dev/null
+expect_equal "malformed loop" 2 $?
+
+# A loop generates its words one at a time: a million of them run in a
+# memory budget where holding them all as arguments fails
+josh_run_limited() {
+    printf '%s\n' "$2" > "$SANDBOX/script.josh"
+    sh -c 'ulimit -v "$1" && exec "$2" "$3"' sh "$1" "$JOSH" "$SANDBOX/script.josh" < /dev/null
+}
+
+expect_equal "large range in constant memory" "1000000" \
+    "$(josh_run_limited 16000 "for i in {1..1000000}; do echo \$i; done" | tail -n 1)"
+josh_run_limited 16000 "echo -n {1..1000000}" 2> /dev/null
+[ $? -ne 0 ] && pass || fail "large range as arguments" "expected to run out of memory"
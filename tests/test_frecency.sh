@@ -0,0 +1,94 @@
+# Directory jumping: ranking of the visited directories, aging of the ranks,
+# forgetting removed directories, and recovery from a corrupted database.
+
+mkdir -p "$SANDBOX/proj_alpha" "$SANDBOX/proj_beta" "$SANDBOX/other"
+alpha="$SANDBOX/proj_alpha"
+beta="$SANDBOX/proj_beta"
+
+josh_run "cd $alpha" "cd $alpha" "cd $alpha" "cd $beta" "cd $SANDBOX/work"
+
+# The best ranked match wins, the last keyword must be in the last component
+expect_equal "best ranked match" "$alpha" "$(josh_run "j proj" "pwd")"
+expect_equal "cd -j" "$alpha" "$(josh_run "cd -j proj" "pwd")"
+expect_equal "keyword in last component" "$beta" "$(josh_run "j beta" "pwd")"
+expect_equal "keywords in order" "$beta" "$(josh_run "j proj bet" "pwd")"
+josh_run "j bet proj" 2> /dev/null
+[ $? -ne 0 ] && pass || fail "keywords out of order" "expected no match"
+expect_equal "current directory is skipped" "$beta" "$(josh_run "cd $alpha" "j proj" "pwd")"
+
+josh_run "j nothing_like_this" 2> /dev/null
+[ $? -ne 0 ] && pass || fail "no match status" "expected non-zero"
+
+# The list has the best ranked directory last
+expect_equal "list order" "$alpha" "$(josh_run "j" | tail -n 1 | awk '{ print $2 }')"
+
+# A removed directory is forgotten once it would have been the answer
+rmdir "$beta"
+josh_run "j beta" 2> /dev/null
+[ $? -ne 0 ] && pass || fail "removed directory status" "expected non-zero"
+case "$(josh_run "j")" in
+    *proj_beta*) fail "removed directory forgotten" "still listed" ;;
+    *) pass ;;
+esac
+
+# Aging: once the ranks add up to more than 10000 they are all scaled by 0.9,
+# and the ones falling under 1 are dropped
+rm -f "$JOSH_FRECENCY_FILE"
+josh_run "cd $SANDBOX/other" "for i in {1..10000}; do cd $alpha; done" > /dev/null
+listing=$(josh_run "j")
+expect_match "aged rank" "^ +36000\.0  $alpha$" "$listing"
+case "$listing" in
+    *"$SANDBOX/other"*) fail "low ranks dropped by aging" "$SANDBOX/other still listed" ;;
+    *) pass ;;
+esac
+
+# Periodic aging: the ranks are scaled by 0.9 for every day since they were
+# last aged, visits or not. set_last_aged SECONDS_AGO writes the time of the
+# last aging (a little endian int64 at offset 24 of the header).
+set_last_aged() {
+    value=$(($(date +%s) - $1))
+    bytes=""
+    for byte in 0 1 2 3 4 5 6 7; do
+        bytes="$bytes\\$(printf '%03o' $(((value >> (8 * byte)) & 255)))"
+    done
+    printf "$bytes" | dd of="$JOSH_FRECENCY_FILE" bs=1 seek=24 conv=notrunc 2> /dev/null
+}
+
+rm -f "$JOSH_FRECENCY_FILE"
+josh_run "for i in {1..10}; do cd $alpha; done" > /dev/null
+set_last_aged $((2 * 86400 + 3600))
+josh_run "cd $SANDBOX/other" > /dev/null
+expect_match "aged after two days" "^ +32\.4  $alpha$" "$(josh_run "j")"
+
+# Not again within the same day
+josh_run "cd $SANDBOX/other" > /dev/null
+expect_match "aged once per day" "^ +32\.4  $alpha$" "$(josh_run "j")"
+
+# Directories not visited for long enough are forgotten
+set_last_aged $((60 * 86400))
+josh_run "cd $SANDBOX/work" > /dev/null
+listing=$(josh_run "j")
+case "$listing" in
+    *"$alpha"*) fail "forgotten after two months" "$alpha still listed" ;;
+    *) pass ;;
+esac
+expect_match "visit after two months" "$SANDBOX/work$" "$listing"
+
+# A corrupted database is started over
+printf 'this is not a frecency database' | dd of="$JOSH_FRECENCY_FILE" conv=notrunc 2> /dev/null
+errors=$(josh_run "j" 2>&1 > /dev/null)
+expect_match "corrupted database reported" "unusable database, starting over" "$errors"
+expect_equal "corrupted database emptied" "" "$(josh_run "j")"
+
+# So is a database with a record whose path overflows it: the length of the
+# first record (right after the 32 bytes header) is set past its buffer
+josh_run "cd $alpha" > /dev/null
+printf '\377\377' | dd of="$JOSH_FRECENCY_FILE" bs=1 seek=40 conv=notrunc 2> /dev/null
+errors=$(josh_run "j" 2>&1 > /dev/null)
+expect_match "corrupted record reported" "unusable database, starting over" "$errors"
+
+# Paths too long for a record are not recorded, with a message
+long="$SANDBOX/$(printf '%0250d' 0)"
+mkdir -p "$long"
+errors=$(josh_run "cd $long" 2>&1)
+expect_match "long path reported" "path too long to be recorded" "$errors"
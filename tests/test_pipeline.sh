@@ -0,0 +1,58 @@
+# Pipelines: data flow between external and builtin stages, exit statuses,
+# the pipe ends each stage gets, and builtins that run in a forked copy of the
+# shell.
+
+expect_equal "external stages" "0ne" "$(josh_run "echo one | tr o 0")"
+expect_equal "builtin stage in the middle" "b" "$(josh_run "echo a | echo b | cat")"
+expect_equal "streaming" "200000" "$(josh_run "seq 200000 | cat | wc -l" | tr -d ' ')"
+expect_equal "end of the reader" "y
+y" "$(josh_run "yes | head -n 2")"
+
+josh_run "true | false"
+expect_equal "status of the last stage" 1 $?
+josh_run "false | true"
+expect_equal "status of the last stage only" 0 $?
+
+josh_run "echo a | | cat" 2> /dev/null
+expect_equal "empty stage" 2 $?
+
+# Every stage only has its own pipe ends: ls sees its stdin, stdout, stderr
+# and the descriptor of the directory it lists, whatever the other stages are
+if [ -d /proc/self/fd ]; then
+    fds="0 1 2 3"
+    expect_equal "fds of an external stage" "$fds" "$(josh_run "ls /proc/self/fd | cat" | xargs)"
+    expect_equal "fds next to a thread stage" "$fds" "$(josh_run "echo x | ls /proc/self/fd | cat" | xargs)"
+    expect_equal "fds next to a forked stage" "$fds" "$(josh_run "cd / | ls /proc/self/fd | cat" | xargs)"
+fi
+
+# Builtins that change the shell run in a copy of it
+expect_equal "forked cd" "$SANDBOX/work" "$(josh_run "cd / | cat" "pwd")"
+
+# A forked exit only ends its copy, and the rest of the script runs once
+expect_equal "forked exit" "one
+two
+three" "$(josh_run "echo one" "exit 3 | cat" "echo two" "echo three")"
+output=$(josh_run "echo x | exit 3" "echo after")
+expect_equal "forked exit as last stage" "after" "$output"
+josh_run "echo x | exit 3"
+expect_equal "status of a forked exit" 3 $?
+
+# Forked and threaded stages together, many times over
+expect_equal "mixed stages repeated" 300 "$(josh_run "for i in {1..300}; do echo \$i | cd / | echo x | cat; done" | wc -l |
+    tr -d ' ')"
+
+# External stages fork before any builtin thread starts: a failed exec next
+# to builtin stages reports its error instead of hanging
+output=$(josh_run "for i in {1..200}; do echo x | josh_missing_command | echo y; done" 2> "$SANDBOX/errors")
+expect_equal "failed exec next to threads" 200 "$(printf '%s\n' "$output" | grep -c y)"
+expect_equal "failed exec reported" 200 "$(grep -c "No such file" "$SANDBOX/errors")"
+
+# A builtin stage reads its input as it streams from the stage before it
+output=$(josh_run "coproc up sed -u s/^/got/" "seq 3 | cowrite up -" "coread up" "coread up" "coread up" \
+    "echo x | cowrite up -" "coread up")
+expect_equal "builtin stage reads its input" "got1
+got2
+got3
+gotx" "$output"
+josh_run "seq 3 | cowrite nothing -" 2> /dev/null
+expect_equal "builtin stage reading for nothing" 1 $?
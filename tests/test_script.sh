@@ -0,0 +1,72 @@
+# Scripts and -c strings: their last command is exec'ed in the shell's own
+# process, and `exec` replaces the shell or redirects its file descriptors.
+
+# The first line prints the pid of its parent (the shell, it is forked), the
+# last one its own pid: the same when it replaced the shell
+pids=$(josh_run "sh -c echo\${IFS}\$PPID" "sh -c echo\${IFS}\$\$")
+expect_equal "last command runs in place" 1 "$(printf '%s\n' "$pids" | sort -u | wc -l | tr -d ' ')"
+
+# Trailing blank lines and comments don't make the command before them any
+# less the last one
+pids=$(josh_run "sh -c echo\${IFS}\$PPID" "sh -c echo\${IFS}\$\$" "" "# done" "   ")
+expect_equal "last command before comments" 1 "$(printf '%s\n' "$pids" | sort -u | wc -l | tr -d ' ')"
+
+# Only the last one: the commands before it are forked and the script goes on
+pids=$(josh_run "sh -c echo\${IFS}\$PPID" "sh -c echo\${IFS}\$\$" "echo end")
+expect_equal "earlier commands are forked" 2 "$(printf '%s\n' "$pids" | grep -v end | sort -u | wc -l | tr -d ' ')"
+
+# Nor with tracing on, the trace needs the end of the command
+pids=$(JOSH_TRACE_FILE="$SANDBOX/trace.json" josh_run "sh -c echo\${IFS}\$PPID" "sh -c echo\${IFS}\$\$")
+expect_equal "no exec in place when tracing" 2 "$(printf '%s\n' "$pids" | sort -u | wc -l | tr -d ' ')"
+
+# Nor for a pipeline
+pids=$(josh_run "sh -c echo\${IFS}\$PPID" "sh -c echo\${IFS}\$\$ | cat")
+expect_equal "no exec in place for a pipeline" 2 "$(printf '%s\n' "$pids" | sort -u | wc -l | tr -d ' ')"
+
+# The status of the script is the one of its last command, exec'ed or not
+josh_run "sh -c exit\${IFS}7"
+expect_equal "status of the last command" 7 $?
+josh_run "josh_missing_command" 2> /dev/null
+expect_equal "status of a failed exec in place" 1 $?
+
+# A missing script file
+"$JOSH" "$SANDBOX/missing.josh" 2> /dev/null
+expect_equal "missing script" 127 $?
+
+# -c runs its string like a script, one command per line
+expect_equal "-c" "a
+b" "$("$JOSH" -c "echo a
+echo b")"
+"$JOSH" -c "sh -c exit\${IFS}5"
+expect_equal "-c status" 5 $?
+pids=$("$JOSH" -c "sh -c echo\${IFS}\$PPID
+sh -c echo\${IFS}\$\$")
+expect_equal "-c last command runs in place" 1 "$(printf '%s\n' "$pids" | sort -u | wc -l | tr -d ' ')"
+
+# exec with a command replaces the shell: nothing after it runs
+output=$(josh_run "exec sh -c exit\${IFS}3" "echo not reached")
+expect_equal "exec status" 3 $?
+expect_equal "exec replaces the shell" "" "$output"
+
+josh_run "exec echo" 2> /dev/null
+expect_equal "exec of a builtin" 1 $?
+
+# exec with only redirections applies them to the shell itself
+output=$(josh_run "exec > $SANDBOX/out" "echo redirected" "sh -c echo\${IFS}child")
+expect_equal "exec >file leaves nothing on stdout" "" "$output"
+expect_equal "exec >file" "redirected
+child" "$(cat "$SANDBOX/out")"
+
+josh_run "echo one" "exec >> $SANDBOX/out" "echo two" > /dev/null
+expect_equal "exec >>file" "redirected
+child
+two" "$(cat "$SANDBOX/out")"
+
+expect_equal "exec 2>&1" "No such file" "$(josh_run "exec 2>&1" "ls $SANDBOX/missing" 2> /dev/null |
+    grep -o "No such file")"
+
+echo "from the file" > "$SANDBOX/in"
+expect_equal "exec <file" "from the file" "$(josh_run "exec < $SANDBOX/in" "cat")"
+
+josh_run "exec > $SANDBOX/missing/out" 2> /dev/null
+expect_equal "exec to a bad target" 1 $?
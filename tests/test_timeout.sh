@@ -0,0 +1,73 @@
+# The timeout and limit builtins: exit statuses of a command that ran out of
+# time (124, or 137 when it had to be killed), and limits applied to it.
+
+cat > "$SANDBOX/ignore_term.sh" <<'SCRIPT'
+trap '' TERM
+sleep 10
+SCRIPT
+
+cat > "$SANDBOX/spin.sh" <<'SCRIPT'
+while :; do :; done
+SCRIPT
+
+# seconds_since START: whole seconds elapsed since the `date +%s` START
+seconds_since() {
+    echo $(($(date +%s) - $1))
+}
+
+start=$(date +%s)
+josh_run "timeout 1 sleep 10"
+expect_equal "timed out status" 124 $?
+[ "$(seconds_since "$start")" -le 3 ] && pass || fail "timed out promptly" "took $(seconds_since "$start")s"
+
+start=$(date +%s)
+josh_run "timeout -k 1 1 sh $SANDBOX/ignore_term.sh"
+expect_equal "killed after ignoring the signal" 137 $?
+[ "$(seconds_since "$start")" -le 4 ] && pass || fail "killed promptly" "took $(seconds_since "$start")s"
+
+# The whole process group gets the signal, not just the direct child
+cat > "$SANDBOX/grandchild.sh" <<'SCRIPT'
+sleep 30 &
+echo $! > "$SANDBOX/grandchild"
+wait
+SCRIPT
+josh_run "timeout 1 sh $SANDBOX/grandchild.sh"
+expect_equal "timed out with a grandchild" 124 $?
+# Reparented to init, it may take a moment to be reaped
+tries=0
+while kill -0 "$(cat "$SANDBOX/grandchild")" 2> /dev/null && [ $tries -lt 20 ]; do
+    sleep 0.1
+    tries=$((tries + 1))
+done
+kill -0 "$(cat "$SANDBOX/grandchild")" 2> /dev/null && fail "no grandchild survives" "still running" || pass
+
+josh_run "timeout -s INT 1 sleep 10"
+expect_equal "custom signal still times out" 124 $?
+
+josh_run "timeout 5 sh -c exit\${IFS}3"
+expect_equal "status of a command on time" 3 $?
+
+# A timeout far beyond what poll can wait at once (about 24.8 days)
+josh_run "timeout 3000000 true"
+expect_equal "huge timeout" 0 $?
+
+josh_run "timeout" 2> /dev/null
+expect_equal "timeout usage status" 125 $?
+
+josh_run "timeout abc true" 2> /dev/null
+expect_equal "invalid duration status" 125 $?
+
+# Output goes through, inside a pipeline as well
+expect_equal "timeout in a pipeline" "hello" "$(josh_run "timeout 5 printf hello | cat")"
+
+# A CPU limit kills the command with SIGXCPU (128 + 24)
+start=$(date +%s)
+josh_run "limit --cpu 1 sh $SANDBOX/spin.sh"
+expect_equal "cpu limit" 152 $?
+[ "$(seconds_since "$start")" -le 4 ] && pass || fail "cpu limit promptly" "took $(seconds_since "$start")s"
+
+# A file descriptor limit is seen by the command
+expect_equal "nofile limit" 16 "$(josh_run "limit --nofile 16 sh -c ulimit\${IFS}-n")"
+
+josh_run "limit" 2> /dev/null
+expect_equal "limit usage status" 125 $?
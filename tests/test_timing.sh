@@ -0,0 +1,69 @@
+# The `time` reserved word and the `times` builtin: their output format, the
+# status `time` passes through, and the phase totals of the shell overhead.
+
+# phase NAME TEXT: seconds of a phase in the output of `time -v` or `times -v`
+phase() {
+    printf '%s\n' "$2" | awk -v name="$1" '$1 == name { sub(/s$/, "", $2); print $2 }'
+}
+
+# at_least NAME MINIMUM VALUE
+at_least() {
+    if awk -v minimum="$2" -v value="$3" 'BEGIN { exit !(value != "" && value + 0 >= minimum) }'; then
+        pass
+    else
+        fail "$1" "expected at least $2, got [$3]"
+    fi
+}
+
+# below NAME MAXIMUM VALUE
+below() {
+    if awk -v maximum="$2" -v value="$3" 'BEGIN { exit !(value != "" && value + 0 < maximum) }'; then
+        pass
+    else
+        fail "$1" "expected less than $2, got [$3]"
+    fi
+}
+
+# The report goes to stderr, the output of the command is left alone
+output=$(josh_run "time sh -c echo\${IFS}out" 2> "$SANDBOX/time")
+expect_equal "time keeps stdout" "out" "$output"
+report=$(cat "$SANDBOX/time")
+expect_match "time real" "^real +[0-9]+\.[0-9]{6}s$" "$report"
+expect_match "time user" "^user +[0-9]+\.[0-9]{6}s$" "$report"
+expect_match "time sys" "^sys +[0-9]+\.[0-9]{6}s$" "$report"
+expect_match "time maxrss" "^maxrss +[1-9][0-9]* KiB$" "$report"
+expect_match "time ctxsw" "^ctxsw +[0-9]+ voluntary, [0-9]+ involuntary$" "$report"
+
+report=$(josh_run "time sleep 0.3" 2>&1)
+at_least "time real of sleep" 0.3 "$(phase real "$report")"
+
+# Builtins and pipelines run in the shell, their max RSS is the shell's own
+expect_match "time of a builtin" "^maxrss +[0-9]+ KiB \(peak of the shell" "$(josh_run "time echo x" 2>&1)"
+expect_match "time of a pipeline" "^maxrss +[0-9]+ KiB \(peak of the shell" "$(josh_run "time echo x | cat" 2>&1)"
+
+# The status of the timed command is the status of `time`
+josh_run "time sh -c exit\${IFS}4" 2> /dev/null
+expect_equal "time status" 4 $?
+josh_run "time" 2> /dev/null
+expect_equal "time without a command" 0 $?
+
+# time -v breaks down the overhead of this command only
+report=$(josh_run "sleep 0.3" "time -v sleep 0.1" 2>&1)
+for name in parse lookup spawn wait builtin; do
+    expect_match "time -v $name" "^  $name +[0-9]+\.[0-9]{6}s$" "$report"
+done
+at_least "time -v wait of the command" 0.1 "$(phase wait "$report")"
+below "time -v leaves out earlier commands" 0.3 "$(phase wait "$report")"
+
+# times: the shell's then its children's user and system times
+report=$(josh_run "times")
+expect_equal "times lines" 2 "$(printf '%s\n' "$report" | grep -cE "^[0-9]+m[0-9]+\.[0-9]{6}s [0-9]+m[0-9]+\.[0-9]{6}s$")"
+
+# times -v adds the phase totals of the whole session
+report=$(josh_run "sleep 0.2" "sleep 0.2" "for i in {1..2000}; do echo \$i; done" "times -v")
+at_least "times -v wait adds up" 0.4 "$(phase wait "$report")"
+at_least "times -v parse" 0.000001 "$(phase parse "$report")"
+at_least "times -v builtin" 0.000001 "$(phase builtin "$report")"
+
+josh_run "times -x" 2> /dev/null
+expect_equal "times usage" 1 $?
@@ -0,0 +1,81 @@
+# Tracing of the shell internals: JOSH_TRACE_FILE and `trace on FILE` write a
+# Chrome trace (a JSON array of events) where every begin event has its end.
+
+# check_trace FILE: prints "ok" and the names of the events if FILE is a JSON
+# array of events whose begin and end events match on every thread, else what
+# is wrong with it
+check_trace() {
+    python3 - "$1" <<'PYTHON'
+import json, sys
+
+try:
+    with open(sys.argv[1]) as trace:
+        events = json.load(trace)
+except (OSError, ValueError) as error:
+    sys.exit("invalid trace: %s" % error)
+
+stacks = {}
+for event in events:
+    if event["ph"] == "B":
+        stacks.setdefault((event["pid"], event["tid"]), []).append(event["name"])
+    elif event["ph"] == "E":
+        stack = stacks.get((event["pid"], event["tid"]))
+        if not stack or stack.pop() != event["name"]:
+            sys.exit("unmatched end of %s" % event["name"])
+for stack in stacks.values():
+    if stack:
+        sys.exit("never ended: %s" % " ".join(stack))
+
+print("ok")
+print("\n".join(sorted(set(event["name"] for event in events))))
+PYTHON
+}
+
+if ! command -v python3 > /dev/null; then
+    echo "skipped: no python3 to parse the traces"
+else
+    # From the environment, for the whole script
+    JOSH_TRACE_FILE="$SANDBOX/env.json" josh_run "echo a" "sh -c true" "echo b | cat" > /dev/null
+    names=$(check_trace "$SANDBOX/env.json" 2>&1)
+    expect_match "environment trace is valid" "^ok$" "$names"
+    for name in process_name parse_arguments echo fork wait pipeline sh cat; do
+        expect_match "environment trace has $name" "^$name$" "$names"
+    done
+
+    # A flush writes what was recorded so far, loadable before the end of the
+    # shell (the closing bracket of the array is optional in the format)
+    JOSH_TRACE_FILE="$SANDBOX/flush.json" josh_run "echo a" "trace flush" "cp $SANDBOX/flush.json $SANDBOX/mid.json" \
+        "echo b" > /dev/null
+    echo "]" >> "$SANDBOX/mid.json"
+    expect_match "flushed events" "\"name\":\"echo\"" "$(cat "$SANDBOX/mid.json")"
+    python3 -c "import json, sys; json.load(open(sys.argv[1]))" "$SANDBOX/mid.json" 2> /dev/null
+    expect_equal "flushed trace parses" 0 $?
+
+    # trace on/off records only what runs in between
+    josh_run "printf before" "trace on $SANDBOX/on.json" "sh -c true" "echo x | cat" "trace off" "printf after" \
+        > /dev/null
+    names=$(check_trace "$SANDBOX/on.json" 2>&1)
+    expect_match "trace on/off is valid" "^ok$" "$names"
+    expect_match "trace on records" "^sh$" "$names"
+    expect_match "trace on records pipelines" "^pipeline$" "$names"
+    case "$names" in
+    *printf*) fail "trace on/off records nothing else" "printf was recorded" ;;
+    *) pass ;;
+    esac
+
+    # Switching files closes the first one properly
+    josh_run "trace on $SANDBOX/first.json" "sh -c true" "trace on $SANDBOX/second.json" "echo x" > /dev/null
+    expect_match "first file of a switch" "^ok$" "$(check_trace "$SANDBOX/first.json" 2>&1)"
+    expect_match "second file of a switch" "^ok$" "$(check_trace "$SANDBOX/second.json" 2>&1)"
+
+    # The shell exiting in the middle of an event still ends it
+    josh_run "trace on $SANDBOX/exit.json" "echo x" "exit 0" > /dev/null
+    expect_match "trace through exit" "^ok$" "$(check_trace "$SANDBOX/exit.json" 2>&1)"
+    echo "echo x" | JOSH_TRACE_FILE="$SANDBOX/repl.json" "$JOSH" > /dev/null
+    expect_match "trace through the end of the input" "^ok$" "$(check_trace "$SANDBOX/repl.json" 2>&1)"
+fi
+
+josh_run "trace" 2> /dev/null
+expect_equal "trace usage" 1 $?
+josh_run "trace on $SANDBOX/missing/trace.json" 2> /dev/null
+expect_equal "trace on a bad file" 1 $?
@@ -0,0 +1,49 @@
+#include "timing.h"
+#include <stdint.h> // For uint64_t
+#include <time.h>   // For clock_gettime
+
+// Cumulative time spent in each phase since the shell started, in nanoseconds.
+// Private to this module, the rest of the shell goes through
+// timing_phase_add/snapshot. Updated atomically, as builtins running on the
+// threads of a pipeline add to them concurrently.
+static uint64_t phase_totals_ns[TIMING_PHASE_COUNT] = {0};
+
+static const char *PHASE_NAMES[TIMING_PHASE_COUNT] = {
+    "parse", "lookup", "spawn", "wait", "builtin",
+};
+
+double timing_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+void timing_phase_add(TimingPhase phase, double seconds)
+{
+    if (phase < 0 || phase >= TIMING_PHASE_COUNT || seconds <= 0)
+    {
+        return;
+    }
+
+    __atomic_fetch_add(&phase_totals_ns[phase], (uint64_t)(seconds * 1e9), __ATOMIC_RELAXED);
+}
+
+void timing_phase_snapshot(double totals[TIMING_PHASE_COUNT])
+{
+    for (int phase = 0; phase < TIMING_PHASE_COUNT; phase++)
+    {
+        totals[phase] = (double)__atomic_load_n(&phase_totals_ns[phase], __ATOMIC_RELAXED) / 1e9;
+    }
+}
+
+const char *timing_phase_name(TimingPhase phase)
+{
+    if (phase < 0 || phase >= TIMING_PHASE_COUNT)
+    {
+        return "unknown";
+    }
+
+    return PHASE_NAMES[phase];
+}
@@ -0,0 +1,54 @@
+#ifndef MYSHELL_TIMING_H
+#define MYSHELL_TIMING_H
+
+// Accounting of where the shell spends its own time. Every command goes through
+// a few well known phases (parse, lookup, spawn, wait or builtin execution) and
+// each of them adds its wall time to a cumulative counter kept by this module.
+// The `time -v` reserved word and the `times -v` builtin read those counters to
+// break down the latency of a command.
+
+/**
+ * @brief The phases of the shell overhead that are measured
+ */
+typedef enum
+{
+    TIMING_PHASE_PARSE,   // Tokenizing the input line
+    TIMING_PHASE_LOOKUP,  // Deciding whether the command is a builtin or not
+    TIMING_PHASE_SPAWN,   // fork() until the parent regains control
+    TIMING_PHASE_WAIT,    // Waiting for the child process to terminate
+    TIMING_PHASE_BUILTIN, // Running a builtin inside the shell process
+    TIMING_PHASE_COUNT    // Number of phases, not a phase itself
+} TimingPhase;
+
+/**
+ * @brief Gets a monotonic timestamp, unaffected by changes of the system clock.
+ *
+ * @return Seconds elapsed since an arbitrary (but fixed) point in the past.
+ */
+double timing_now(void);
+
+/**
+ * @brief Adds the given amount of time to the cumulative counter of a phase.
+ *
+ * @param phase   Phase the time was spent in.
+ * @param seconds Wall time spent, in seconds.
+ */
+void timing_phase_add(TimingPhase phase, double seconds);
+
+/**
+ * @brief Copies the current cumulative counters of all the phases.
+ *
+ * @param totals Array where the totals (in seconds) are written, indexed by
+ *               TimingPhase.
+ */
+void timing_phase_snapshot(double totals[TIMING_PHASE_COUNT]);
+
+/**
+ * @brief Gets the human readable name of a phase.
+ *
+ * @param phase Phase to name.
+ * @return A static string with the name of the phase.
+ */
+const char *timing_phase_name(TimingPhase phase);
+
+#endif // !MYSHELL_TIMING_H
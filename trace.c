@@ -0,0 +1,315 @@
+#include "trace.h"
+#include <stdint.h>      // For uint64_t
+#include <stdio.h>       // For FILE, fopen, fprintf
+#include <stdlib.h>      // For getenv, atexit
+#include <string.h>      // For strncpy
+#include <sys/syscall.h> // For SYS_gettid
+#include <time.h>        // For clock_gettime
+#include <unistd.h>      // For getpid, syscall
+
+// Array sizes must be integer constant expressions in C, so an enum is used
+// here instead of `static const`.
+enum
+{
+    TRACE_RING_CAPACITY = 8192, // Number of events kept in memory
+    TRACE_NAME_LENGTH = 48,     // Longest event name stored (longer are cut)
+};
+
+// Name of the environment variable that enables tracing at startup
+static const char *TRACE_FILE_ENV = "JOSH_TRACE_FILE";
+
+// A single Chrome Trace Event. The name is copied into the event because the
+// strings given by the callers (e.g. the arguments of a command) may be freed
+// before the ring buffer is flushed.
+typedef struct
+{
+    uint64_t sequence;     // Ring index + 1 once published, 0 while being written
+    uint64_t timestamp_us; // Microseconds on the monotonic clock
+    pid_t tid;             // Thread id, or pid of the child for child lifetimes
+    char phase;            // 'B' (begin) or 'E' (end)
+    bool child;            // Whether it is the lifetime of a child process
+    char name[TRACE_NAME_LENGTH];
+} TraceEvent;
+
+// The ring buffer is lock-free: writers claim a slot with an atomic increment
+// of ring_head and publish it by storing its sequence number last. The flusher
+// (always the shell's main thread) only reads slots whose sequence matches the
+// index it expects: it stops at the first slot not published yet, and counts
+// the slots already overwritten as dropped.
+static TraceEvent ring[TRACE_RING_CAPACITY];
+static uint64_t ring_head = 0; // Next index to be claimed by a writer
+static uint64_t ring_tail = 0; // Next index to be flushed
+
+static bool enabled = false;
+static FILE *trace_file = NULL;
+static pid_t owner_pid = 0;         // Only this process may write the file
+static bool events_written = false; // Whether a separator is needed
+static uint64_t dropped_events = 0; // Events overwritten before a flush
+static bool exit_handler_set = false;
+
+// =================================================================
+// Private helpers
+// =================================================================
+
+static uint64_t trace_timestamp_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static pid_t trace_current_tid(void)
+{
+    static __thread pid_t cached_tid = 0;
+
+    if (cached_tid == 0)
+    {
+        cached_tid = (pid_t)syscall(SYS_gettid);
+    }
+
+    return cached_tid;
+}
+
+static void trace_record(char phase, pid_t tid, bool child, const char *name)
+{
+    if (!__atomic_load_n(&enabled, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    uint64_t index = __atomic_fetch_add(&ring_head, 1, __ATOMIC_RELAXED);
+    TraceEvent *event = &ring[index % TRACE_RING_CAPACITY];
+
+    // Mark the slot as being written, so a concurrent flush ignores it. The
+    // fence keeps the fields below from being seen before this mark.
+    __atomic_store_n(&event->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    event->timestamp_us = trace_timestamp_us();
+    event->tid = tid;
+    event->phase = phase;
+    event->child = child;
+    strncpy(event->name, name != NULL ? name : "?", TRACE_NAME_LENGTH - 1);
+    event->name[TRACE_NAME_LENGTH - 1] = '\0';
+
+    __atomic_store_n(&event->sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+static void trace_write_separator(void)
+{
+    fprintf(trace_file, events_written ? ",\n" : "\n");
+    events_written = true;
+}
+
+static void trace_write_name(const char *name)
+{
+    fputc('"', trace_file);
+    for (const char *c = name; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fprintf(trace_file, "\\%c", *c);
+        }
+        else if ((unsigned char)*c < 0x20)
+        {
+            fprintf(trace_file, "\\u%04x", (unsigned char)*c);
+        }
+        else
+        {
+            fputc(*c, trace_file);
+        }
+    }
+    fputc('"', trace_file);
+}
+
+static void trace_write_event(const TraceEvent *event)
+{
+    trace_write_separator();
+    fprintf(trace_file, "{\"name\":");
+    trace_write_name(event->name);
+    fprintf(trace_file, ",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+            event->child ? "child" : "shell", event->phase, (unsigned long long)event->timestamp_us, (int)owner_pid,
+            (int)event->tid);
+}
+
+static void trace_exit_handler(void)
+{
+    // A child that failed to exec also runs the atexit handlers, it must not
+    // touch the trace file of its parent.
+    if (getpid() == owner_pid)
+    {
+        trace_stop();
+    }
+}
+
+// =================================================================
+// Public functions
+// =================================================================
+
+bool trace_start(const char *file_path)
+{
+    if (trace_file != NULL)
+    {
+        trace_stop();
+    }
+
+    trace_file = fopen(file_path, "w");
+    if (trace_file == NULL)
+    {
+        return false;
+    }
+
+    owner_pid = getpid();
+    events_written = false;
+    dropped_events = 0;
+    ring_tail = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+
+    if (!exit_handler_set)
+    {
+        atexit(trace_exit_handler);
+        exit_handler_set = true;
+    }
+
+    // The closing bracket is optional in the JSON array format, so the file
+    // can be loaded even if the shell dies before trace_stop is called.
+    fprintf(trace_file, "[");
+    trace_write_separator();
+    fprintf(trace_file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"josh\"}}",
+            (int)owner_pid);
+
+    __atomic_store_n(&enabled, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+void trace_start_from_env(void)
+{
+    const char *file_path = getenv(TRACE_FILE_ENV);
+
+    if (file_path != NULL && file_path[0] != '\0' && !trace_start(file_path))
+    {
+        perror("myshell: trace");
+    }
+}
+
+void trace_stop(void)
+{
+    if (trace_file == NULL)
+    {
+        return;
+    }
+
+    __atomic_store_n(&enabled, false, __ATOMIC_RELEASE);
+    trace_flush();
+
+    // Events whose writer never finished them can't be written anymore
+    uint64_t unfinished = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) - ring_tail;
+    if (unfinished > 0)
+    {
+        fprintf(stderr, "myshell: trace: %llu events were dropped\n", (unsigned long long)unfinished);
+    }
+
+    fprintf(trace_file, "\n]\n");
+    fclose(trace_file);
+    trace_file = NULL;
+}
+
+void trace_flush(void)
+{
+    if (trace_file == NULL)
+    {
+        return;
+    }
+
+    uint64_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    uint64_t start = ring_tail;
+
+    // Writers lapped the flusher: the oldest events are already overwritten
+    if (head - start > TRACE_RING_CAPACITY)
+    {
+        dropped_events += head - start - TRACE_RING_CAPACITY;
+        start = head - TRACE_RING_CAPACITY;
+    }
+
+    uint64_t index = start;
+    for (; index < head; index++)
+    {
+        const TraceEvent *slot = &ring[index % TRACE_RING_CAPACITY];
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+        // Not published yet: the flush stops there and the next one resumes
+        // from this slot, so the event is neither lost nor written out of order
+        if (sequence < index + 1)
+        {
+            break;
+        }
+
+        // Already reused by a writer that lapped the flusher
+        if (sequence > index + 1)
+        {
+            dropped_events++;
+            continue;
+        }
+
+        TraceEvent event = *slot;
+
+        // The slot may have been reused while it was being copied. The fence
+        // keeps the copy from being read after the check.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != index + 1)
+        {
+            dropped_events++;
+            continue;
+        }
+
+        trace_write_event(&event);
+    }
+
+    ring_tail = index;
+    fflush(trace_file);
+
+    if (dropped_events > 0)
+    {
+        fprintf(stderr, "myshell: trace: %llu events were dropped\n", (unsigned long long)dropped_events);
+        dropped_events = 0;
+    }
+}
+
+void trace_flush_if_needed(void)
+{
+    if (trace_file == NULL)
+    {
+        return;
+    }
+
+    uint64_t pending = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) - ring_tail;
+    if (pending >= TRACE_RING_CAPACITY / 2)
+    {
+        trace_flush();
+    }
+}
+
+bool trace_enabled(void)
+{
+    return __atomic_load_n(&enabled, __ATOMIC_RELAXED);
+}
+
+void trace_begin(const char *name)
+{
+    trace_record('B', trace_current_tid(), false, name);
+}
+
+void trace_end(const char *name)
+{
+    trace_record('E', trace_current_tid(), false, name);
+}
+
+void trace_child_begin(pid_t pid, const char *name)
+{
+    trace_record('B', pid, true, name);
+}
+
+void trace_child_end(pid_t pid, const char *name)
+{
+    trace_record('E', pid, true, name);
+}
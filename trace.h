@@ -0,0 +1,84 @@
+#ifndef MYSHELL_TRACE_H
+#define MYSHELL_TRACE_H
+
+#include <stdbool.h>
+#include <sys/types.h> // For pid_t
+
+// Opt-in tracing of the shell internals. When enabled, timestamped begin/end
+// events are recorded into an in-memory ring buffer and flushed to a file in
+// the Chrome Trace Event format (JSON array flavour), which can be loaded in
+// chrome://tracing, Perfetto or speedscope.
+//
+// Tracing is off by default and every recording function returns immediately
+// in that case, so the instrumentation can stay in the hot paths.
+
+/**
+ * @brief Starts tracing into the given file, truncating it. If tracing was
+ *  already enabled, the previous file is flushed and closed first.
+ *
+ * @param file_path Path of the file the events are written to.
+ * @return true on success, false if the file could not be opened.
+ */
+bool trace_start(const char *file_path);
+
+/**
+ * @brief Starts tracing if the JOSH_TRACE_FILE environment variable is set.
+ *  Also makes sure the events are flushed when the shell exits.
+ */
+void trace_start_from_env(void);
+
+/**
+ * @brief Flushes the pending events and stops tracing.
+ */
+void trace_stop(void);
+
+/**
+ * @brief Writes the pending events of the ring buffer to the trace file.
+ */
+void trace_flush(void);
+
+/**
+ * @brief Flushes the pending events only if the ring buffer is getting full.
+ *  Meant to be called between commands so that events are not overwritten.
+ */
+void trace_flush_if_needed(void);
+
+/**
+ * @brief Checks whether tracing is enabled.
+ *
+ * @return true if events are being recorded, false otherwise.
+ */
+bool trace_enabled(void);
+
+/**
+ * @brief Records the beginning of a span of the shell itself.
+ *
+ * @param name Name of the span, e.g. "read_line".
+ */
+void trace_begin(const char *name);
+
+/**
+ * @brief Records the end of a span of the shell itself.
+ *
+ * @param name Name of the span, must match the one given to trace_begin.
+ */
+void trace_end(const char *name);
+
+/**
+ * @brief Records the beginning of the lifetime of a child process. It is shown
+ *  as its own track (the child pid is used as the thread id).
+ *
+ * @param pid  Pid of the child.
+ * @param name Name of the span, usually the command being run.
+ */
+void trace_child_begin(pid_t pid, const char *name);
+
+/**
+ * @brief Records the end of the lifetime of a child process.
+ *
+ * @param pid  Pid of the child.
+ * @param name Name of the span, must match the one given to trace_child_begin.
+ */
+void trace_child_end(pid_t pid, const char *name);
+
+#endif // !MYSHELL_TRACE_H